@@ -48,8 +48,8 @@ void setup() {
   tfLuna.setMaxDistanceThreshold(500, maxDistanceCallback); // 500cm maximum
   Serial.println("Distance thresholds set: 30cm min, 500cm max");
   
-  // Enable logging to Serial
-  tfLuna.beginLogging(&Serial);
+  // Enable logging to Serial, as text since the serial monitor shows it
+  tfLuna.beginLogging(&Serial, TFLUNA_LOG_TEXT);
   Serial.println("Logging enabled");
   
   // Set continuous mode (default)
@@ -0,0 +1,70 @@
+// Filter Pipeline Example for TF-Luna LiDAR Module
+// This example demonstrates composing distance filters at compile time.
+//
+// The Arduino build output ("Sketch uses ... bytes of program storage space",
+// "Global variables use ... bytes") reports the flash and RAM cost of the
+// selected configuration. Change FILTER_CONFIG and rebuild to compare them.
+
+#include <TFLuna.h>
+#include <TFLunaFilters.h>
+
+#define FILTER_CONFIG 3
+
+#if FILTER_CONFIG == 1
+// Spike rejection only
+typedef TFLunaFilterPipeline<TFLunaMedianFilter<5> > DistanceFilter;
+#elif FILTER_CONFIG == 2
+// Same chain as TFLunaAdvanced with both filters enabled
+typedef TFLunaFilterPipeline<TFLunaMedianFilter<5>, TFLunaMeanFilter<4> > DistanceFilter;
+#elif FILTER_CONFIG == 3
+// Gate large jumps, smooth, then hold the output steady around a target
+typedef TFLunaFilterPipeline<TFLunaOutlierGate<50>,
+                             TFLunaMedianFilter<3>,
+                             TFLunaEMAFilter<64>,
+                             TFLunaDeadbandFilter<1> > DistanceFilter;
+#else
+// Lightest option: exponential smoothing alone
+typedef TFLunaFilterPipeline<TFLunaEMAFilter<32> > DistanceFilter;
+#endif
+
+// Create TFLuna instance with Serial1
+TFLuna tfLuna(&Serial1);
+DistanceFilter distanceFilter;
+
+void setup() {
+  // Initialize serial monitor
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // Wait for serial port to connect
+  }
+  
+  Serial.println("TF-Luna Filter Pipeline Example");
+  Serial.print("Filter configuration ");
+  Serial.print(FILTER_CONFIG);
+  Serial.print(" uses ");
+  Serial.print(sizeof(DistanceFilter));
+  Serial.println(" bytes of RAM");
+  
+  // Initialize TF-Luna with 115200 baud rate (default)
+  if (!tfLuna.begin(115200)) {
+    Serial.print("Failed to initialize TF-Luna. Error code: ");
+    Serial.println(tfLuna.getErrorCode());
+    while (1) {
+      ; // Halt if initialization fails
+    }
+  }
+}
+
+void loop() {
+  // Filter every frame as it arrives
+  while (tfLuna.poll()) {
+    uint16_t raw = tfLuna.getDistance();
+    uint16_t filtered = distanceFilter.process(raw);
+    
+    Serial.print("Raw: ");
+    Serial.print(raw);
+    Serial.print(" cm, Filtered: ");
+    Serial.print(filtered);
+    Serial.println(" cm");
+  }
+}
@@ -21,7 +21,7 @@ void setup() {
   
   // Initialize TF-Luna in I2C mode
   // Note: Make sure pin 5 of TF-Luna is connected to GND before powering on
-  if (tfLuna.beginI2C()) {
+  if (tfLuna.beginI2C(TF_LUNA_ADDRESS)) {
     Serial.println("TF-Luna initialized in I2C mode");
   } else {
     Serial.print("Failed to initialize TF-Luna. Error code: ");
@@ -1,12 +1,14 @@
 // Multiple Sensors Example for TF-Luna LiDAR Module
-// This example demonstrates how to use multiple TF-Luna sensors with I2C
+// This example demonstrates how to use multiple TF-Luna sensors with I2C.
+// TFLunaArray schedules the reads on the shared bus, so each sensor is read
+// as often as the bus allows instead of once per fixed delay.
 
 #include <TFLuna.h>
+#include <TFLunaArray.h>
 #include <Wire.h>
 
-// Create TFLuna instances for I2C
-TFLuna tfLuna1;
-TFLuna tfLuna2;
+// One scheduler for all sensors on the bus
+TFLunaArray sensors;
 
 // I2C addresses for the sensors
 // Note: The default address is 0x10, you need to change the address of one sensor
@@ -22,36 +24,24 @@ void setup() {
   
   Serial.println("TF-Luna Multiple Sensors Example");
   
-  // Initialize I2C
-  Wire.begin();
+  // Register the sensors. With TFLUNA_ARRAY_RATE each sensor is read at its
+  // target rate (Hz); with the default round robin they are read in turn.
+  sensors.addSensor(TF_LUNA_ADDR1, 100);
+  sensors.addSensor(TF_LUNA_ADDR2, 100);
+  sensors.setSchedule(TFLUNA_ARRAY_RATE);
   
-  // Initialize first TF-Luna sensor
-  if (tfLuna1.beginI2C()) {
-    Serial.println("First TF-Luna initialized successfully");
-  } else {
-    Serial.print("Failed to initialize first TF-Luna. Error code: ");
-    Serial.println(tfLuna1.getErrorCode());
-    while (1) {
-      ; // Halt if initialization fails
-    }
-  }
-  
-  // Initialize second TF-Luna sensor
-  if (tfLuna2.beginI2C()) {
-    Serial.println("Second TF-Luna initialized successfully");
-  } else {
-    Serial.print("Failed to initialize second TF-Luna. Error code: ");
-    Serial.println(tfLuna2.getErrorCode());
-    while (1) {
-      ; // Halt if initialization fails
-    }
+  // Initialize I2C and wait for both sensors to answer; fast mode roughly
+  // quadruples the reads per second
+  if (!sensors.begin()) {
+    Serial.println("Not all sensors answered, check wiring and addresses");
   }
+  Wire.setClock(400000);
   
   // Note: Before using this example, you need to change the I2C address of one sensor
   // This can be done using the following code (uncomment to use):
   /*
   // Change the address of the second sensor (connect only one sensor at a time)
-  if (tfLuna2.setI2CAddress(TF_LUNA_ADDR2, TF_LUNA_ADDR1)) {
+  if (sensors.getBus().setI2CAddress(TF_LUNA_ADDR2, TF_LUNA_ADDR1)) {
     Serial.println("Address changed successfully");
     Serial.println("Please power cycle the sensor for the new address to take effect");
     while (1) {
@@ -66,37 +56,42 @@ void setup() {
   Serial.println();
 }
 
-void loop() {
-  // Get data from first TF-Luna
-  if (tfLuna1.getDataI2C(TF_LUNA_ADDR1)) {
-    Serial.print("Sensor 1 - Distance: ");
-    Serial.print(tfLuna1.getDistance());
-    Serial.print(" cm, Strength: ");
-    Serial.print(tfLuna1.getSignalStrength());
-    Serial.print(", Temp: ");
-    Serial.print(tfLuna1.getTemperature() / 100.0);
-    Serial.println(" °C");
-  } else {
-    Serial.print("Sensor 1 - Error: ");
-    Serial.println(tfLuna1.getErrorCode());
-  }
+void printSensor(uint8_t index) {
+  const TFLuna::Sample& sample = sensors.getSample(index);
   
-  // Get data from second TF-Luna
-  if (tfLuna2.getDataI2C(TF_LUNA_ADDR2)) {
-    Serial.print("Sensor 2 - Distance: ");
-    Serial.print(tfLuna2.getDistance());
-    Serial.print(" cm, Strength: ");
-    Serial.print(tfLuna2.getSignalStrength());
-    Serial.print(", Temp: ");
-    Serial.print(tfLuna2.getTemperature() / 100.0);
-    Serial.println(" °C");
-  } else {
-    Serial.print("Sensor 2 - Error: ");
-    Serial.println(tfLuna2.getErrorCode());
+  Serial.print("Sensor ");
+  Serial.print(index + 1);
+  if (sensors.getErrorCode(index) != TFLUNA_OK) {
+    Serial.print(" - Error: ");
+    Serial.println(sensors.getErrorCode(index));
+    return;
   }
+  Serial.print(" - Distance: ");
+  Serial.print(sample.distance);
+  Serial.print(" cm, Strength: ");
+  Serial.print(sample.strength);
+  Serial.print(", Temp: ");
+  Serial.print(sample.temperature / 100.0);
+  Serial.print(" °C, Rate: ");
+  Serial.print(sensors.getAchievedRate(index));
+  Serial.println(" Hz");
+}
+
+void loop() {
+  // Runs the next due read, returns immediately when none is due
+  sensors.update();
   
-  Serial.println();
-  
-  // Wait 100ms before next reading
-  delay(100);
+  // Report the latest samples every 500 ms
+  static uint32_t lastReport = 0;
+  if (millis() - lastReport >= 500) {
+    lastReport = millis();
+    
+    for (uint8_t i = 0; i < sensors.getSensorCount(); i++) {
+      printSensor(i);
+    }
+    Serial.print("Bus utilisation: ");
+    Serial.print(sensors.getBusUtilisation());
+    Serial.println(" %");
+    Serial.println();
+  }
 }
@@ -0,0 +1,123 @@
+// Helpers shared by the fuzz harnesses.
+#ifndef TFLUNA_FUZZ_INPUT_H
+#define TFLUNA_FUZZ_INPUT_H
+
+#include <Arduino.h>
+#include <TFLuna.h>
+#include <stdio.h>
+
+// A failed check is a finding: report it and abort so the fuzzer keeps the input
+#define FUZZ_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            abort(); \
+        } \
+    } while (0)
+
+// Mock clock step per read. Large enough that blocking calls time out after a
+// few hundred reads, so one input runs in well under a millisecond.
+#define FUZZ_MICROS_PER_READ 1000
+
+// Same clock for every input, so a crash reproduces from the input alone
+inline void fuzzResetClock() {
+    hostClockReset();
+    hostClockSetAutoAdvance(FUZZ_MICROS_PER_READ);
+}
+
+// Reads typed values off the fuzzer's input; past the end everything is zero
+class FuzzInput {
+public:
+    FuzzInput(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+    bool empty() const {
+        return _index >= _size;
+    }
+
+    uint8_t byte() {
+        return _index < _size ? _data[_index++] : 0;
+    }
+
+    uint16_t word() {
+        uint16_t low = byte();
+        return low | (uint16_t)byte() << 8;
+    }
+
+    // Up to length bytes, returns how many there were
+    size_t take(const uint8_t* &bytes, size_t length) {
+        size_t left = _size - (_index < _size ? _index : _size);
+        if (length > left) {
+            length = left;
+        }
+        bytes = _data + _index;
+        _index += length;
+        return length;
+    }
+
+    // Whatever is left
+    size_t rest(const uint8_t* &bytes) {
+        return take(bytes, _size);
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _index = 0;
+};
+
+// Stream that receives bytes from the fuzz input. Everything written to it must
+// be a well formed command frame.
+class FuzzStream : public Stream {
+public:
+    void setData(const uint8_t* data, size_t length) {
+        _data = data;
+        _length = length;
+        _readIndex = 0;
+    }
+
+    int available() override {
+        return _length - _readIndex;
+    }
+
+    int read() override {
+        if (_readIndex < _length) {
+            return _data[_readIndex++];
+        }
+        return -1;
+    }
+
+    int peek() override {
+        if (_readIndex < _length) {
+            return _data[_readIndex];
+        }
+        return -1;
+    }
+
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        FUZZ_CHECK(size >= TFLUNA_CMD_MIN_LENGTH && size <= TFLUNA_CMD_MAX_LENGTH);
+        FUZZ_CHECK(buffer[0] == TFLUNA_CMD_HEADER && buffer[1] == size);
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < size - 1; i++) {
+            checksum += buffer[i];
+        }
+        FUZZ_CHECK(checksum == buffer[size - 1]);
+        _commands++;
+        return size;
+    }
+
+    uint32_t commands() const {
+        return _commands;
+    }
+
+private:
+    const uint8_t* _data = NULL;
+    size_t _length = 0;
+    size_t _readIndex = 0;
+    uint32_t _commands = 0;
+};
+
+#endif // TFLUNA_FUZZ_INPUT_H
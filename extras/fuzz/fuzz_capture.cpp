@@ -0,0 +1,120 @@
+// Capture replay: TFLunaReplayStream over arbitrary files.
+//
+// The bytes replayed must be exactly those of a straightforward walk over the
+// chunk records, in both replay modes, and recording the replay with
+// TFLunaRecorder must give a capture that replays to the same bytes.
+#include "FuzzInput.h"
+#include <TFLunaCapture.h>
+#include <vector>
+
+// Capture written to memory
+class FuzzCapture : public Print {
+public:
+    std::vector<uint8_t> bytes;
+
+    size_t write(uint8_t data) override {
+        bytes.push_back(data);
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        bytes.insert(bytes.end(), buffer, buffer + size);
+        return size;
+    }
+};
+
+// Reference reader, following the format description in TFLunaCapture.h
+static bool walkCapture(const uint8_t* data, size_t size, std::vector<uint8_t> &bytes) {
+    size_t index = TFLUNA_CAPTURE_HEADER_LENGTH;
+    while (index < size) {
+        uint8_t shift = 0;
+        while (true) {
+            if (index >= size || shift > 28) {
+                return true;
+            }
+            uint8_t byte = data[index++];
+            if (!(byte & 0x80)) {
+                break;
+            }
+            shift += 7;
+        }
+        if (index >= size || data[index] == 0 || index + 1 + data[index] > size) {
+            return true;
+        }
+        uint8_t count = data[index++];
+        bytes.insert(bytes.end(), data + index, data + index + count);
+        index += count;
+    }
+    return false;
+}
+
+static void readAll(TFLunaReplayStream &replay, std::vector<uint8_t> &bytes, size_t limit) {
+    for (size_t i = 0; i <= limit; i++) {
+        int peeked = replay.peek();
+        int byte = replay.read();
+        FUZZ_CHECK(peeked == byte);
+        if (byte < 0) {
+            return;
+        }
+        bytes.push_back(byte);
+    }
+    FUZZ_CHECK(!"replay gave more bytes than the capture holds");
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzResetClock();
+
+    TFLunaReplayStream replay;
+    bool valid = size >= TFLUNA_CAPTURE_HEADER_LENGTH &&
+                 memcmp(data, TFLUNA_CAPTURE_MAGIC, 4) == 0 && data[4] == TFLUNA_CAPTURE_VERSION;
+    FUZZ_CHECK(replay.begin(data, size) == valid);
+    if (!valid) {
+        FUZZ_CHECK(replay.read() < 0 && replay.isFinished());
+        return 0;
+    }
+
+    std::vector<uint8_t> expected;
+    bool truncated = walkCapture(data, size, expected);
+
+    // As fast as it is read
+    std::vector<uint8_t> bytes;
+    readAll(replay, bytes, size);
+    FUZZ_CHECK(bytes == expected);
+    FUZZ_CHECK(replay.isFinished());
+    FUZZ_CHECK(replay.isTruncated() == truncated);
+    FUZZ_CHECK(replay.getReplayedBytes() == expected.size());
+
+    // In real time, with the clock jumping ahead whenever nothing is due
+    replay.begin(data, size, true);
+    bytes.clear();
+    for (size_t i = 0; i <= (size + 1) * 32 && !replay.isFinished(); i++) {
+        if (replay.available() == 0) {
+            hostClockAdvance(0x1000000);
+            continue;
+        }
+        bytes.push_back(replay.read());
+    }
+    FUZZ_CHECK(bytes == expected);
+
+    // Through the parser, recorded on the way
+    replay.begin(data, size);
+    TFLunaRecorder recorder(&replay);
+    TFLuna sensor(&recorder);
+    FuzzCapture capture;
+    FUZZ_CHECK(recorder.begin(&capture, replay.getBaudRate()));
+    for (size_t i = 0; i <= expected.size() && !replay.isFinished(); i++) {
+        sensor.poll();
+    }
+    FUZZ_CHECK(replay.isFinished());
+    recorder.end();
+    FUZZ_CHECK(recorder.getRecordedBytes() == expected.size());
+
+    TFLunaReplayStream again;
+    FUZZ_CHECK(again.begin(capture.bytes.data(), capture.bytes.size()));
+    FUZZ_CHECK(again.getBaudRate() == replay.getBaudRate());
+    bytes.clear();
+    readAll(again, bytes, capture.bytes.size());
+    FUZZ_CHECK(bytes == expected);
+    FUZZ_CHECK(!again.isTruncated());
+    return 0;
+}
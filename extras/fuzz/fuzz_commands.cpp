@@ -0,0 +1,207 @@
+// Command engine and configuration: the input is a sequence of operations on a
+// UART sensor, with replies and frames taken from the input as well.
+//
+// Every command the library writes must be well formed (checked by
+// FuzzStream), and tickets, statuses and statistics must stay consistent
+// whatever the sensor answers and whenever it answers.
+#include "FuzzInput.h"
+#include <TFLunaAdvanced.h>
+
+#define FUZZ_MAX_TICKETS 16
+
+// The port rate is changed in place, so the baud paths run to the end
+class FuzzSensor : public TFLunaAdvanced {
+public:
+    using TFLunaAdvanced::TFLunaAdvanced;
+
+protected:
+    bool _canSetPortBaud() const override {
+        return true;
+    }
+
+    bool _setPortBaud(uint32_t baudRate) override {
+        return true;
+    }
+};
+
+static FuzzSensor* s_sensor = nullptr;
+static uint8_t s_requeue = 0;          // Commands callbacks may still queue
+static uint32_t s_callbacks = 0;
+
+static void onCommand(uint8_t ticket, uint8_t command, uint8_t errorCode) {
+    FUZZ_CHECK(ticket != 0);
+    FUZZ_CHECK(s_sensor->getCommandStatus(ticket) == (errorCode == TFLUNA_OK ? TFLUNA_CMD_DONE
+                                                                              : TFLUNA_CMD_FAILED));
+    s_callbacks++;
+
+    // Callbacks may queue the next command
+    if (s_requeue > 0) {
+        s_requeue--;
+        uint8_t payload = command;
+        s_sensor->queueCommand(command, &payload, 1, onCommand);
+    }
+}
+
+static const uint32_t baudRates[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzResetClock();
+    FuzzInput input(data, size);
+    FuzzStream port;
+    FuzzSensor sensor(&port);
+    s_sensor = &sensor;
+    s_requeue = 0;
+    s_callbacks = 0;
+
+    uint8_t tickets[FUZZ_MAX_TICKETS] = {};
+    uint8_t ticketCount = 0;
+
+    while (!input.empty()) {
+        const uint8_t* bytes;
+        size_t length;
+        size_t consumed;
+        size_t dropped;
+        uint8_t payload[8];
+        TFLuna::Sample samples[4];
+
+        switch (input.byte() % 16) {
+            case 0:
+                // Bytes arrive; unread ones are lost
+                length = input.take(bytes, input.byte());
+                port.setData(bytes, length);
+                break;
+
+            case 1:
+                sensor.poll();
+                break;
+
+            case 2:
+                if (input.byte() & 1) {
+                    sensor.getData();
+                } else {
+                    FUZZ_CHECK(!sensor.getDataI2C());   // Not in I2C mode
+                }
+                break;
+
+            case 3:
+                sensor.feed(input.byte());
+                break;
+
+            case 4:
+                sensor.setFrameRate(input.word());
+                break;
+
+            case 5:
+                if (sensor.setOutputFormat(input.byte() % 8)) {
+                    FUZZ_CHECK(sensor.getOutputFormat() == TFLUNA_FORMAT_CM ||
+                               sensor.getOutputFormat() == TFLUNA_FORMAT_MM);
+                }
+                break;
+
+            case 6:
+                switch (input.byte() % 8) {
+                    case 0: sensor.setTriggerMode(); break;
+                    case 1: sensor.setContinuousMode(); break;
+                    case 2: sensor.triggerSample(); break;
+                    case 3: sensor.setEnable(); break;
+                    case 4: sensor.setDisable(); break;
+                    case 5: sensor.setSaveSettings(); break;
+                    case 6: sensor.setSoftReset(); break;
+                    default: sensor.setHardReset(); break;
+                }
+                break;
+
+            case 7: {
+                uint8_t choice = input.byte();
+                uint32_t baudRate = choice < 128 ? baudRates[choice % 8]
+                                                 : (uint32_t)input.word() << 8 | input.byte();
+                bool supported = TFLuna::isSupportedBaudRate(baudRate);
+                bool result = sensor.setBaudRate(baudRate);
+                FUZZ_CHECK(supported || !result);
+                FUZZ_CHECK(!result || sensor.getBaudRate() == baudRate);
+                break;
+            }
+
+            case 8: {
+                // Any id and payload length, valid or not
+                uint8_t id = input.byte();
+                uint8_t payloadLen = input.byte() % 8;
+                for (uint8_t i = 0; i < payloadLen; i++) {
+                    payload[i] = input.byte();
+                }
+                uint8_t flags = input.byte();
+                s_requeue = flags >> 6;
+                uint8_t ticket = sensor.queueCommand(id, payload, payloadLen,
+                                                     (flags & 1) ? onCommand : nullptr);
+                if (payloadLen > TFLUNA_CMD_MAX_PAYLOAD) {
+                    FUZZ_CHECK(ticket == 0);
+                }
+                if (ticket != 0 && ticketCount < FUZZ_MAX_TICKETS) {
+                    tickets[ticketCount++] = ticket;
+                }
+                break;
+            }
+
+            case 9:
+                sensor.serviceCommands();
+                break;
+
+            case 10:
+                if (input.byte() & 1) {
+                    sensor.startSoftReset();
+                } else {
+                    sensor.startHardReset();
+                }
+                break;
+
+            case 11:
+                if (input.byte() & 1) {
+                    FUZZ_CHECK(sensor.pollReady() <= TFLUNA_READY_FAILED);
+                } else {
+                    sensor.waitReady();
+                }
+                break;
+
+            case 12:
+                hostClockAdvance((uint32_t)input.word() * 100);
+                break;
+
+            case 13: {
+                length = input.take(bytes, input.byte());
+                size_t maxSamples = input.byte() % 4 + 1;
+                size_t count = sensor.decodeFrames(bytes, length, samples, maxSamples, consumed, dropped);
+                FUZZ_CHECK(count <= maxSamples && consumed <= length);
+                FUZZ_CHECK(consumed == length || count == maxSamples);
+                break;
+            }
+
+            case 14:
+                if (sensor.detectBaudRate() != 0) {
+                    FUZZ_CHECK(TFLuna::isSupportedBaudRate(sensor.getBaudRate()));
+                }
+                break;
+
+            default:
+                sensor.resetStatistics();
+                break;
+        }
+
+        // Invariants after every operation
+        for (uint8_t i = 0; i < ticketCount; i++) {
+            uint8_t status = sensor.getCommandStatus(tickets[i]);
+            FUZZ_CHECK(status <= TFLUNA_CMD_FAILED);
+            if (status == TFLUNA_CMD_FAILED) {
+                FUZZ_CHECK(sensor.getCommandError(tickets[i]) != TFLUNA_OK);
+            }
+        }
+        FUZZ_CHECK(sensor.getDistanceUnit() == TFLUNA_UNIT_CM ||
+                   sensor.getDistanceUnit() == TFLUNA_UNIT_MM);
+
+        TFLuna::Statistics stats;
+        sensor.getStatistics(stats);
+        FUZZ_CHECK(stats.nacks == 0 && stats.shortReads == 0);   // No I2C traffic
+    }
+
+    s_sensor = nullptr;
+    return 0;
+}
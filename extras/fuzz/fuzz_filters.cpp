@@ -0,0 +1,218 @@
+// TFLunaAdvanced processing and the filter stages, driven by arbitrary
+// measurements and configuration changes.
+//
+// The median and mean stages are checked against a plain sort and sum of the
+// same window; the other stages, the tracker, the conversions and the logger
+// must stay in range and not crash.
+#include "FuzzInput.h"
+#include <TFLunaAdvanced.h>
+#include <TFLunaFilters.h>
+#include <TFLunaTracker.h>
+#include <algorithm>
+
+#define FUZZ_MEDIAN_WINDOW 9
+#define FUZZ_MEAN_WINDOW   16
+
+// Log output that takes as much as the input allows
+class FuzzSink : public Print {
+public:
+    int space = 0;
+    size_t accept = 0;
+
+    int availableForWrite() override {
+        return space;
+    }
+
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return size < accept ? size : accept;
+    }
+};
+
+static uint16_t s_minDistance;
+static uint16_t s_maxDistance;
+static uint32_t s_thresholdCalls;
+
+static void onThreshold(uint16_t distance) {
+    s_thresholdCalls++;
+}
+
+static void makeFrame(uint8_t* frame, uint16_t distance, uint16_t strength, uint16_t temperature) {
+    frame[0] = TFLUNA_FRAME_HEADER;
+    frame[1] = TFLUNA_FRAME_HEADER;
+    frame[2] = distance & 0xFF;
+    frame[3] = distance >> 8;
+    frame[4] = strength & 0xFF;
+    frame[5] = strength >> 8;
+    frame[6] = temperature & 0xFF;
+    frame[7] = temperature >> 8;
+    frame[8] = 0;
+    for (uint8_t i = 0; i < TFLUNA_FRAME_LENGTH - 1; i++) {
+        frame[8] += frame[i];
+    }
+}
+
+// Stages against a reference computed from the whole window every time
+static void checkStages(FuzzInput &input) {
+    TFLunaMedianFilter<FUZZ_MEDIAN_WINDOW> median;
+    TFLunaMeanFilter<FUZZ_MEAN_WINDOW> mean;
+    TFLunaEMAFilter<64> ema;
+    TFLunaDeadbandFilter<5> deadband;
+    TFLunaOutlierGate<100, 2> gate;
+    TFLunaTracker tracker;
+
+    uint16_t history[256];
+    uint8_t historyCount = 0;
+    median.setWindow(input.byte());
+    mean.setWindow(input.byte());
+    tracker.setFrameRate(input.word());
+
+    uint8_t count = input.byte();
+    for (uint8_t n = 0; n < count && !input.empty(); n++) {
+        uint16_t value = input.word();
+        history[historyCount++] = value;
+
+        // Median over the last window values, or the raw value until full
+        uint16_t result = median.process(value);
+        uint8_t window = median.getWindow();
+        FUZZ_CHECK(window >= 1 && window <= FUZZ_MEDIAN_WINDOW && window % 2 == 1);
+        if (historyCount >= window) {
+            uint16_t sorted[FUZZ_MEDIAN_WINDOW];
+            memcpy(sorted, &history[historyCount - window], window * sizeof(uint16_t));
+            std::sort(sorted, sorted + window);
+            FUZZ_CHECK(result == sorted[window / 2]);
+        } else {
+            FUZZ_CHECK(result == value);
+        }
+
+        result = mean.process(value);
+        window = mean.getWindow();
+        FUZZ_CHECK(window >= 1 && window <= FUZZ_MEAN_WINDOW);
+        if (historyCount >= window) {
+            uint32_t sum = 0;
+            for (uint8_t i = historyCount - window; i < historyCount; i++) {
+                sum += history[i];
+            }
+            FUZZ_CHECK(result == sum / window);
+        } else {
+            FUZZ_CHECK(result == value);
+        }
+
+        ema.process(value);
+        // The deadband holds its output only while the input stays within the band
+        result = deadband.process(value);
+        FUZZ_CHECK((result > value ? result - value : value - result) <= 5);
+        gate.process(value);
+        FUZZ_CHECK(gate.getRejectCount() <= 2);
+
+        tracker.update(value, input.word(), input.byte());
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzResetClock();
+    FuzzInput input(data, size);
+
+    if (input.byte() & 1) {
+        checkStages(input);
+        return 0;
+    }
+
+    FuzzStream port;
+    TFLunaAdvanced sensor(&port);
+    FuzzSink sink;
+    s_minDistance = 0xFFFF;
+    s_maxDistance = 0;
+    s_thresholdCalls = 0;
+
+    uint8_t frame[TFLUNA_FRAME_LENGTH];
+    TFLuna::Sample samples[1];
+    uint32_t out32[1];
+    int32_t outSigned[1];
+    uint8_t out8[1];
+
+    while (!input.empty()) {
+        switch (input.byte() % 12) {
+            case 0: sensor.enableMedianFilter(input.byte()); break;
+            case 1: sensor.disableMedianFilter(); break;
+            case 2: sensor.enableAverageFilter(input.byte()); break;
+            case 3: sensor.disableAverageFilter(); break;
+            case 4: sensor.enableTracking(input.word()); break;
+            case 5: sensor.disableTracking(); break;
+
+            case 6: {
+                uint16_t threshold = input.word();
+                if (input.byte() & 1) {
+                    sensor.setMinDistanceThreshold(threshold, onThreshold);
+                } else {
+                    sensor.setMaxDistanceThreshold(threshold, onThreshold);
+                }
+                break;
+            }
+
+            case 7:
+                sensor.clearDistanceThresholds();
+                break;
+
+            case 8:
+                sink.space = input.byte();
+                sink.accept = input.byte();
+                sensor.beginLogging(&sink, input.byte() & 1);
+                break;
+
+            case 9:
+                sink.space = input.byte();
+                sink.accept = input.byte();
+                if (input.byte() & 1) {
+                    sensor.flushLog();
+                } else {
+                    sensor.endLogging();
+                }
+                break;
+
+            case 10:
+                hostClockAdvance(input.word());
+                break;
+
+            default: {
+                // One measurement, sometimes corrupted so the sequence has gaps
+                uint16_t distance = input.word();
+                makeFrame(frame, distance, input.word(), input.word());
+                uint8_t corrupt = input.byte();
+                if (corrupt < TFLUNA_FRAME_LENGTH) {
+                    frame[corrupt] ^= 0x40;
+                }
+                port.setData(frame, TFLUNA_FRAME_LENGTH);
+                if (!sensor.getData()) {
+                    break;
+                }
+                s_minDistance = std::min(s_minDistance, distance);
+                s_maxDistance = std::max(s_maxDistance, distance);
+
+                // Median and mean both stay within the values they were given
+                uint16_t filtered = sensor.getDistance();
+                FUZZ_CHECK(filtered >= s_minDistance && filtered <= s_maxDistance);
+                FUZZ_CHECK(sensor.getSignalQuality() <= 100);
+
+                sensor.getSample(samples[0]);
+                TFLunaAdvanced::toMillimeters(samples, out32, 1);
+                FUZZ_CHECK(out32[0] == sensor.getDistanceInMillimeters());
+                TFLunaAdvanced::toMetersQ16(samples, out32, 1);
+                FUZZ_CHECK(out32[0] == sensor.getDistanceInMetersQ16());
+                TFLunaAdvanced::toCentiFahrenheit(samples, outSigned, 1);
+                FUZZ_CHECK(outSigned[0] == sensor.getTemperatureInCentiFahrenheit());
+                TFLunaAdvanced::toSignalQuality(samples, out8, 1);
+                FUZZ_CHECK(out8[0] == sensor.getSignalQuality());
+                sensor.getTrackedDistance();
+                sensor.getVelocity();
+                break;
+            }
+        }
+    }
+
+    sensor.endLogging();
+    return 0;
+}
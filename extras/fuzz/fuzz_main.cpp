@@ -0,0 +1,196 @@
+// Driver for the fuzz harnesses where libFuzzer is not available (GCC, or AFL
+// with an input file argument).
+//
+//   fuzz_x [-runs=N] [-seed=S] [-max_len=L] FILE|DIR...
+//
+// Runs every file given, and every file in the directories given, once. With
+// -runs, N more inputs are made by mutating those at random, which finds
+// shallow bugs without coverage feedback. Other libFuzzer flags are ignored, so
+// the same command line works for both builds. An input that fails is saved as
+// crash-<n> in the working directory.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+extern "C" void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+typedef std::vector<uint8_t> Input;
+
+static const Input* s_current = NULL;
+static unsigned long s_runs = 0;
+
+// Keep the input that brought the harness down
+static void saveCurrent() {
+    if (s_current == NULL) {
+        return;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "crash-%lu", s_runs);
+    FILE* file = fopen(name, "wb");
+    if (file != NULL) {
+        fwrite(s_current->data(), 1, s_current->size(), file);
+        fclose(file);
+        fprintf(stderr, "input saved to %s\n", name);
+    }
+    s_current = NULL;
+}
+
+static void onSignal(int signal) {
+    saveCurrent();
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+static bool readFile(const std::string &path, Input &input) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        input.insert(input.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+static void addPath(const std::string &path, std::vector<Input> &corpus) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        fprintf(stderr, "%s: not found\n", path.c_str());
+        exit(2);
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        corpus.push_back(Input());
+        readFile(path, corpus.back());
+        return;
+    }
+
+    // Sorted, so runs are repeatable
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++) {
+        addPath(path + "/" + names[i], corpus);
+    }
+}
+
+// xorshift32, seeded from the command line
+static uint32_t s_random = 1;
+
+static uint32_t nextRandom() {
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+static void mutate(Input &input, size_t maxLength) {
+    uint32_t count = nextRandom() % 8 + 1;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t position = input.empty() ? 0 : nextRandom() % input.size();
+        switch (nextRandom() % 6) {
+            case 0:
+                if (!input.empty()) {
+                    input[position] ^= 1 << (nextRandom() % 8);
+                }
+                break;
+            case 1:
+                if (!input.empty()) {
+                    input[position] = nextRandom();
+                }
+                break;
+            case 2:
+                input.insert(input.begin() + position, (uint8_t)nextRandom());
+                break;
+            case 3:
+                if (!input.empty()) {
+                    input.erase(input.begin() + position);
+                }
+                break;
+            case 4:
+                // Repeat a block, e.g. a whole frame
+                if (!input.empty()) {
+                    size_t length = std::min<size_t>(nextRandom() % 16 + 1, input.size() - position);
+                    Input block(input.begin() + position, input.begin() + position + length);
+                    input.insert(input.begin() + nextRandom() % (input.size() + 1), block.begin(), block.end());
+                }
+                break;
+            default:
+                input.resize(position);
+                break;
+        }
+    }
+    if (input.size() > maxLength) {
+        input.resize(maxLength);
+    }
+}
+
+static void run(const Input &input) {
+    s_current = &input;
+    LLVMFuzzerTestOneInput(input.empty() ? NULL : input.data(), input.size());
+    s_current = NULL;
+    s_runs++;
+}
+
+int main(int argc, char** argv) {
+    unsigned long extraRuns = 0;
+    size_t maxLength = 512;
+    std::vector<Input> corpus;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            extraRuns = strtoul(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-seed=", 6) == 0) {
+            s_random = strtoul(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-max_len=", 9) == 0) {
+            maxLength = strtoul(argv[i] + 9, NULL, 10);
+        } else if (argv[i][0] != '-') {
+            addPath(argv[i], corpus);
+        }
+    }
+    if (s_random == 0) {
+        s_random = 1;
+    }
+
+    signal(SIGABRT, onSignal);
+    signal(SIGSEGV, onSignal);
+    signal(SIGFPE, onSignal);
+    if (__sanitizer_set_death_callback != NULL) {
+        __sanitizer_set_death_callback(saveCurrent);
+    }
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        run(corpus[i]);
+    }
+
+    Input input;
+    for (unsigned long i = 0; i < extraRuns; i++) {
+        if (!corpus.empty() && nextRandom() % 4 != 0) {
+            input = corpus[nextRandom() % corpus.size()];
+        }
+        mutate(input, maxLength);
+        run(input);
+    }
+
+    printf("%lu inputs, %zu from the corpus\n", s_runs, corpus.size());
+    return 0;
+}
@@ -0,0 +1,93 @@
+// UART parser: the same bytes fed one at a time, drained by poll() and decoded
+// by decodeFrames() in chunks must give the same samples and statistics.
+//
+// Input: decodeFrames() chunk length, its sample limit, then the received bytes.
+#include "FuzzInput.h"
+
+#define FUZZ_MAX_SAMPLES 1024   // Compared per input, later frames only counted
+
+static bool sameSample(const TFLuna::Sample &a, const TFLuna::Sample &b) {
+    return a.distance == b.distance && a.strength == b.strength &&
+           a.temperature == b.temperature && a.sequence == b.sequence && a.unit == b.unit;
+}
+
+static bool sameStatistics(const TFLuna &a, const TFLuna &b) {
+    TFLuna::Statistics statsA;
+    TFLuna::Statistics statsB;
+    a.getStatistics(statsA);
+    b.getStatistics(statsB);
+    return memcmp(&statsA, &statsB, sizeof(statsA)) == 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzResetClock();
+    FuzzInput input(data, size);
+    size_t chunk = input.byte() % 32 + 1;
+    size_t maxSamples = input.byte() % 8 + 1;
+    const uint8_t* bytes;
+    size_t length = input.rest(bytes);
+
+    // Reference: one byte at a time
+    static TFLuna::Sample expected[FUZZ_MAX_SAMPLES];
+    size_t expectedCount = 0;
+    FuzzStream portA;
+    TFLuna byByte(&portA);
+    for (size_t i = 0; i < length; i++) {
+        if (byByte.feed(bytes[i])) {
+            if (expectedCount < FUZZ_MAX_SAMPLES) {
+                byByte.getSample(expected[expectedCount]);
+            }
+            expectedCount++;
+        }
+    }
+
+    // poll() stops at every frame and drains the port otherwise
+    FuzzStream portB;
+    TFLuna polled(&portB);
+    portB.setData(bytes, length);
+    size_t polledCount = 0;
+    while (polled.poll()) {
+        if (polledCount < FUZZ_MAX_SAMPLES) {
+            TFLuna::Sample sample;
+            polled.getSample(sample);
+            FUZZ_CHECK(sameSample(sample, expected[polledCount]));
+        }
+        polledCount++;
+    }
+    FUZZ_CHECK(portB.available() == 0);
+    FUZZ_CHECK(polledCount == expectedCount);
+    FUZZ_CHECK(sameStatistics(polled, byByte));
+
+    // decodeFrames() takes the fast path for aligned frames, which must not
+    // change the result
+    FuzzStream portC;
+    TFLuna batched(&portC);
+    TFLuna::Sample samples[8];
+    size_t batchedCount = 0;
+    size_t offset = 0;
+    while (offset < length) {
+        size_t n = length - offset < chunk ? length - offset : chunk;
+        size_t consumed = 0;
+        size_t dropped = 0;
+        size_t count = batched.decodeFrames(bytes + offset, n, samples, maxSamples, consumed, dropped);
+        FUZZ_CHECK(count <= maxSamples);
+        FUZZ_CHECK(consumed > 0 && consumed <= n);
+        FUZZ_CHECK(count + dropped <= consumed);
+        for (size_t i = 0; i < count; i++, batchedCount++) {
+            if (batchedCount < FUZZ_MAX_SAMPLES) {
+                FUZZ_CHECK(sameSample(samples[i], expected[batchedCount]));
+            }
+        }
+        if (count > 0) {
+            FUZZ_CHECK(batched.getDistance() == samples[count - 1].distance);
+        }
+        offset += consumed;
+    }
+    FUZZ_CHECK(batchedCount == expectedCount);
+    FUZZ_CHECK(sameStatistics(batched, byByte));
+    FUZZ_CHECK(batched.getDistance() == byByte.getDistance());
+
+    // No commands were queued, so nothing may have been sent
+    FUZZ_CHECK(portA.commands() == 0 && portB.commands() == 0 && portC.commands() == 0);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Write the seed corpus of the fuzz harnesses into extras/fuzz/corpus.
+
+Seeds are valid sensor traffic in the input layout of each harness, so the
+fuzzers start from inputs that reach deep into the parsers. The output is
+checked in; run this again after changing a harness's input layout.
+
+Usage:
+    make_corpus.py [OUTPUT_DIR]
+"""
+
+import os
+import struct
+import sys
+
+FRAME_HEADER = 0x59
+CMD_HEADER = 0x5A
+
+
+def checksum(data):
+    return bytes([sum(data) & 0xFF])
+
+
+def frame(distance, strength=1000, temperature=2816):
+    body = bytes([FRAME_HEADER, FRAME_HEADER]) + struct.pack("<HHH", distance, strength, temperature)
+    return body + checksum(body)
+
+
+def reply(command, payload=b""):
+    body = bytes([CMD_HEADER, len(payload) + 4, command]) + payload
+    return body + checksum(body)
+
+
+def word(value):
+    return struct.pack("<H", value)
+
+
+def receive(data):
+    """fuzz_commands: bytes arriving on the port."""
+    return bytes([0, len(data)]) + data
+
+
+def capture(chunks, baud=115200):
+    """A TFLunaRecorder capture of (us since the previous chunk, bytes)."""
+    out = b"TFLC" + bytes([1]) + struct.pack("<I", baud)
+    for delta, data in chunks:
+        while delta >= 0x80:
+            out += bytes([(delta & 0x7F) | 0x80])
+            delta >>= 7
+        out += bytes([delta, len(data)]) + data
+    return out
+
+
+def seeds():
+    frames = frame(120) + frame(121) + frame(119)
+    bad = bytearray(frame(300))
+    bad[8] ^= 0xFF
+
+    uart = {
+        "frame": b"\x09\x01" + frame(150),
+        "frames_chunked": b"\x04\x02" + frames,
+        "noise_resync": b"\x10\x03" + b"\x00\x59\x12" + frame(80) + b"\x59" + frame(81),
+        "bad_checksum": b"\x09\x01" + bytes(bad) + frame(301),
+        "reply_between": b"\x07\x04" + frame(10) + reply(0x03, word(100)) + frame(11),
+        "reply_as_noise": b"\x05\x01" + b"\x5a\x02" + frame(12) + b"\x5a\x59\x59" + frame(13)[2:],
+        "reply_after_stray": b"\x09\x01" + frame(14) + b"\x5a" + reply(0x03, word(100)) + frame(15),
+        "reply_after_frame_header": b"\x09\x01" + frame(16) + b"\x59" + reply(0x03, word(100)) + frame(17),
+        "split_frame": b"\x05\x08" + frame(500)[:4] + frame(500)[4:] + frame(501),
+    }
+
+    commands = {
+        "frame_rate": receive(reply(0x03, word(50))) + b"\x04" + word(50),
+        "output_format": receive(reply(0x05, b"\x06")) + b"\x05\x06" + receive(frames) + b"\x02\x01",
+        "get_data": receive(frames) + b"\x02\x01\x02\x01\x01\x0f",
+        "queued": b"\x08\x07\x01\x01\x01" + receive(reply(0x07, b"\x01")) + b"\x01\x09",
+        "queued_chained": b"\x08\x05\x01\x06\x41" + receive(reply(0x05, b"\x06")) + b"\x01"
+                          + receive(reply(0x05, b"\x05")) + b"\x01\x0c\xff\xff\x09",
+        "trigger": receive(frame(200)) + b"\x06\x00\x06\x02\x02\x01",
+        "soft_reset": receive(reply(0x02, b"\x00") + frames) + b"\x0a\x01\x0b\x01\x0b\x00",
+        "save": receive(reply(0x11, b"\x00")) + b"\x06\x05",
+        "baud_rate": receive(reply(0x06, struct.pack("<I", 115200)) + frames) + b"\x07\x04",
+        "detect": receive(frames + frames) + b"\x0e",
+        "timeout": b"\x04" + word(10) + b"\x0c\x00\x10\x09",
+        "decode": b"\x0d\x1b" + frames + b"\x03",
+    }
+
+    def measurement(distance, strength=1000, temperature=2816, corrupt=0xFF):
+        return b"\x0b" + word(distance) + word(strength) + word(temperature) + bytes([corrupt])
+
+    readings = b"".join(measurement(d) for d in (100, 104, 98, 250, 101, 99, 103))
+    filters = {
+        "median": b"\x00" + b"\x00\x05" + readings,
+        "average": b"\x00" + b"\x02\x04" + readings,
+        "both": b"\x00" + b"\x00\x03\x02\x03" + readings + b"\x01" + readings,
+        "tracking": b"\x00" + b"\x04" + word(100) + readings + measurement(105, corrupt=3) + readings,
+        "thresholds": b"\x00" + b"\x06" + word(150) + b"\x00\x06" + word(50) + b"\x01" + readings + b"\x07",
+        "logging": b"\x00" + b"\x08\x40\x40\x00" + readings + b"\x09\x10\x08\x01"
+                   + b"\x08\x40\x20\x01" + readings + b"\x09\x00\x00\x00",
+        "weak_signal": b"\x00" + measurement(800, strength=10) + measurement(800, strength=65535),
+        "stages": b"\x01\x05\x04" + word(100) + bytes([12])
+                  + b"".join(word(d) + word(1000) + b"\x01" for d in (100, 104, 98, 250, 101, 99, 103, 400,
+                                                                        402, 399, 0, 65535)),
+    }
+
+    captures = {
+        "frames": capture([(0, frames[:9]), (10000, frames[9:18]), (10000, frames[18:])]),
+        "one_chunk": capture([(5, frames)]),
+        "long_gap": capture([(0, frame(1)), (0x12345678, frame(2))]),
+        "truncated": capture([(0, frames)])[:-5],
+        "empty": capture([]),
+    }
+
+    return {"uart_parser": uart, "commands": commands, "filters": filters, "capture": captures}
+
+
+def main(argv):
+    root = argv[1] if len(argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus")
+    for harness, inputs in seeds().items():
+        directory = os.path.join(root, harness)
+        os.makedirs(directory, exist_ok=True)
+        for name, data in inputs.items():
+            with open(os.path.join(directory, name), "wb") as output:
+                output.write(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,260 @@
+#include "Arduino.h"
+#include "Wire.h"
+
+#include <stdio.h>
+#include <time.h>
+
+// Clock
+static bool s_realTime = false;
+static uint32_t s_autoAdvance = 1;
+static uint64_t s_mockMicros = 0;
+static uint64_t s_realStart = 0;
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void hostClockUseRealTime(bool enable) {
+    s_realTime = enable;
+    s_realStart = monotonicMicros() - s_mockMicros;
+}
+
+void hostClockSetAutoAdvance(uint32_t microsPerRead) { s_autoAdvance = microsPerRead; }
+void hostClockAdvance(uint32_t us) { s_mockMicros += us; }
+void hostClockReset() { s_mockMicros = 0; s_realStart = monotonicMicros(); }
+
+static uint64_t nowMicros() {
+    if (s_realTime) {
+        return monotonicMicros() - s_realStart;
+    }
+    s_mockMicros += s_autoAdvance;
+    return s_mockMicros;
+}
+
+uint32_t micros() { return (uint32_t)nowMicros(); }
+uint32_t millis() { return (uint32_t)(nowMicros() / 1000ULL); }
+
+void delay(uint32_t ms) { delayMicroseconds(ms * 1000UL); }
+
+void delayMicroseconds(uint32_t us) {
+    if (s_realTime) {
+        uint64_t end = monotonicMicros() + us;
+        while (monotonicMicros() < end) {
+        }
+    } else {
+        s_mockMicros += us;
+    }
+}
+
+void yield() {}
+
+// Print
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::write(const char* str) {
+    return str ? write((const uint8_t*)str, strlen(str)) : 0;
+}
+
+size_t Print::_printNumber(unsigned long value, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char* p = &buf[sizeof(buf) - 1];
+    *p = '\0';
+    if (base < 2) base = 10;
+    do {
+        unsigned long digit = value % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value);
+    return write(p);
+}
+
+size_t Print::print(const char* str) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return _printNumber(value, base); }
+size_t Print::print(int value, int base) { return print((long)value, base); }
+size_t Print::print(unsigned int value, int base) { return _printNumber(value, base); }
+size_t Print::print(unsigned long value, int base) { return _printNumber(value, base); }
+
+size_t Print::print(long value, int base) {
+    if (base == 10 && value < 0) {
+        return write('-') + _printNumber((unsigned long)-value, 10);
+    }
+    return _printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(double value, int digits) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return write(buf);
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const char* str) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char value, int base) { return print(value, base) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+
+// Stream
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    uint32_t start = millis();
+    while (count < length) {
+        int c = read();
+        if (c < 0) {
+            if (millis() - start >= _timeout) {
+                break;
+            }
+            continue;
+        }
+        buffer[count++] = (uint8_t)c;
+    }
+    return count;
+}
+
+// HardwareSerial
+HardwareSerial Serial(true);
+HardwareSerial Serial1;
+
+int HardwareSerial::available() {
+    return (int)((_rxHead + RX_SIZE - _rxTail) % RX_SIZE);
+}
+
+int HardwareSerial::read() {
+    if (_rxHead == _rxTail) {
+        return -1;
+    }
+    uint8_t c = _rx[_rxTail];
+    _rxTail = (_rxTail + 1) % RX_SIZE;
+    return c;
+}
+
+int HardwareSerial::peek() {
+    return _rxHead == _rxTail ? -1 : _rx[_rxTail];
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+    if (_echo) {
+        fputc(data, stdout);
+    }
+    return 1;
+}
+
+void HardwareSerial::inject(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        size_t next = (_rxHead + 1) % RX_SIZE;
+        if (next == _rxTail) {
+            return;
+        }
+        _rx[_rxHead] = data[i];
+        _rxHead = next;
+    }
+}
+
+// TwoWire
+TwoWire Wire;
+TwoWire Wire1;
+
+bool TwoWire::attach(uint8_t addr, HostI2CDevice* device) {
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        if (_devices[i] == nullptr || _addrs[i] == addr) {
+            _addrs[i] = addr;
+            _devices[i] = device;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TwoWire::detach(uint8_t addr) {
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        if (_devices[i] != nullptr && _addrs[i] == addr) {
+            _devices[i] = nullptr;
+        }
+    }
+}
+
+// In real-time mode a transfer takes as long as on the wire: 9 clocks per
+// byte including the address byte. The thread sleeps, like a CPU waiting for
+// an interrupt-driven controller, so transfers on different buses overlap.
+static void simulateTransfer(bool enabled, uint32_t clock, uint32_t bytes) {
+    if (!enabled || !s_realTime || clock == 0) {
+        return;
+    }
+    uint64_t ns = (uint64_t)bytes * 9ULL * 1000000000ULL / clock;
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    nanosleep(&ts, NULL);
+}
+
+HostI2CDevice* TwoWire::_find(uint8_t addr) {
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        if (_devices[i] != nullptr && _addrs[i] == addr) {
+            return _devices[i];
+        }
+    }
+    return nullptr;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+    _txAddr = addr;
+    _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (_txLength >= BUFFER_LENGTH) {
+        return 0;
+    }
+    _tx[_txLength++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    (void)sendStop;
+    _transactions++;
+    _bytes += 1 + _txLength;
+    simulateTransfer(_simulateTiming, _clock, 1 + _txLength);
+    HostI2CDevice* device = _find(_txAddr);
+    if (device == nullptr) {
+        return 2; // Address NACK
+    }
+    return device->onWrite(_tx, _txLength) ? 0 : 3;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t quantity, bool sendStop) {
+    (void)sendStop;
+    _transactions++;
+    _rxIndex = 0;
+    _rxLength = 0;
+    if (quantity > BUFFER_LENGTH) {
+        quantity = BUFFER_LENGTH;
+    }
+    HostI2CDevice* device = _find(addr);
+    if (device == nullptr) {
+        return 0;
+    }
+    _rxLength = (uint8_t)device->onRead(_rx, quantity);
+    _bytes += 1 + _rxLength;
+    simulateTransfer(_simulateTiming, _clock, 1 + _rxLength);
+    return _rxLength;
+}
+
+int TwoWire::read() {
+    return _rxIndex < _rxLength ? _rx[_rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+    return _rxIndex < _rxLength ? _rx[_rxIndex] : -1;
+}
@@ -0,0 +1,38 @@
+// Minimal Arduino core shim for building the library on a Linux host.
+#ifndef TFLUNA_HOST_ARDUINO_H
+#define TFLUNA_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+using std::min;
+using std::max;
+
+// Mock clock. By default time only moves when delay() is called or when the
+// clock auto-advances on each read, which keeps busy-wait loops finite and
+// test runs deterministic. Benchmarks switch to the real monotonic clock.
+void hostClockUseRealTime(bool enable);
+void hostClockSetAutoAdvance(uint32_t microsPerRead);
+void hostClockAdvance(uint32_t us);
+void hostClockReset();
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+#endif // TFLUNA_HOST_ARDUINO_H
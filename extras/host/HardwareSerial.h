@@ -0,0 +1,41 @@
+#ifndef TFLUNA_HOST_HARDWARESERIAL_H
+#define TFLUNA_HOST_HARDWARESERIAL_H
+
+#include "Stream.h"
+
+// Host serial port. Transmitted bytes go to stdout (Serial) or are kept for
+// inspection; received bytes are injected by tests with inject().
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(bool echo = false) : _echo(echo) {}
+
+    void begin(unsigned long baud) { _baud = baud; _beginCount++; }
+    void end() {}
+    unsigned long baudRate() const { return _baud; }
+    unsigned long beginCount() const { return _beginCount; }
+    operator bool() const { return true; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t data) override;
+    using Print::write;
+    int availableForWrite() override { return 64; }
+
+    void inject(const uint8_t* data, size_t length);
+    void clearRx() { _rxHead = _rxTail = 0; }
+
+private:
+    static const size_t RX_SIZE = 4096;
+    bool _echo;
+    unsigned long _baud = 0;
+    unsigned long _beginCount = 0;
+    uint8_t _rx[RX_SIZE];
+    size_t _rxHead = 0;
+    size_t _rxTail = 0;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // TFLUNA_HOST_HARDWARESERIAL_H
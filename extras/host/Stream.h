@@ -0,0 +1,22 @@
+#ifndef TFLUNA_HOST_STREAM_H
+#define TFLUNA_HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t readBytes(char* buffer, size_t length) {
+        return readBytes((uint8_t*)buffer, length);
+    }
+
+protected:
+    unsigned long _timeout = 1000;
+};
+
+#endif // TFLUNA_HOST_STREAM_H
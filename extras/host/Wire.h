@@ -0,0 +1,71 @@
+#ifndef TFLUNA_HOST_WIRE_H
+#define TFLUNA_HOST_WIRE_H
+
+#include "Stream.h"
+
+// Simulated I2C target attached to a host TwoWire bus.
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {}
+    // Bytes written in one transaction (register pointer first). Return
+    // false to NACK.
+    virtual bool onWrite(const uint8_t* data, size_t length) = 0;
+    // Fill up to length bytes for a read transaction; return the count.
+    virtual size_t onRead(uint8_t* data, size_t length) = 0;
+};
+
+class TwoWire : public Stream {
+public:
+    static const uint8_t BUFFER_LENGTH = 32;
+    static const uint8_t MAX_DEVICES = 8;
+
+    void begin() { _begun = true; }
+    void setClock(uint32_t clock) { _clock = clock; }
+    uint32_t getClock() const { return _clock; }
+
+    void beginTransmission(uint8_t addr);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true);
+    uint8_t requestFrom(int addr, int quantity) {
+        return requestFrom((uint8_t)addr, (uint8_t)quantity);
+    }
+
+    size_t write(uint8_t data) override;
+    using Print::write;
+    int available() override { return _rxLength - _rxIndex; }
+    int read() override;
+    int peek() override;
+
+    // Host-only helpers
+    bool attach(uint8_t addr, HostI2CDevice* device);
+    void detach(uint8_t addr);
+    uint32_t transactionCount() const { return _transactions; }
+    uint32_t bytesTransferred() const { return _bytes; }
+    void resetCounters() { _transactions = 0; _bytes = 0; }
+    // In real-time mode transfers take their time on the wire unless this is
+    // turned off, e.g. to measure only the library's own overhead
+    void simulateTiming(bool enable) { _simulateTiming = enable; }
+
+private:
+    HostI2CDevice* _find(uint8_t addr);
+
+    bool _begun = false;
+    uint32_t _clock = 100000;
+    uint8_t _txAddr = 0;
+    uint8_t _tx[BUFFER_LENGTH];
+    uint8_t _txLength = 0;
+    uint8_t _rx[BUFFER_LENGTH];
+    uint8_t _rxLength = 0;
+    uint8_t _rxIndex = 0;
+    uint8_t _addrs[MAX_DEVICES] = {0};
+    HostI2CDevice* _devices[MAX_DEVICES] = {nullptr};
+    uint32_t _transactions = 0;
+    uint32_t _bytes = 0;
+    bool _simulateTiming = true;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+#define WIRE_INTERFACES_COUNT 2
+
+#endif // TFLUNA_HOST_WIRE_H
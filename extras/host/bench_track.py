@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Run the host benchmark and compare it against earlier runs.
+
+Every line of the form
+
+    <name>: <total> us total, <per item> us/item
+
+(with an optional " RAM: <n> bytes, time" after the name) is one result.
+The benchmark is run --repeat times and the fastest time of each result is
+kept, which filters out most scheduling noise. Each result is compared with
+the median of the last runs in the history CSV, then the run is appended to
+it. A result more than --threshold percent slower than that median is
+reported as a regression. Changes below --min-delta us/item are ignored as
+timer noise.
+
+Each row records whether its result passed. Only passed results form the
+baseline, so a regression stays reported until it is fixed, or accepted with
+--accept after an intended slowdown; results of a benchmark that failed its
+checks never count.
+
+Usage:
+    bench_track.py [--history FILE] [--threshold PCT] [--runs N] [--repeat N]
+                   [--min-delta US] [--no-fail] [--accept] BENCHMARK [ARGS...]
+    bench_track.py --parse OUTPUT.txt ...      results of earlier runs
+
+Exit status is 1 when a benchmark failed or regressed.
+"""
+
+import argparse
+import csv
+import datetime
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+RESULT = re.compile(r"^(?P<name>.+?)(?: RAM: \d+ bytes, time)?: "
+                    r"(?P<total>\d+) us total, (?P<per>[0-9.]+) us/item")
+COLUMNS = ["date", "revision", "benchmark", "us_per_item", "status"]
+PASSED = "passed"
+
+
+def parse(output, results):
+    """Add the results in output to {name: us per item}, keeping the fastest."""
+    for line in output.splitlines():
+        match = RESULT.match(line.strip())
+        if match:
+            name = match.group("name")
+            value = float(match.group("per"))
+            results[name] = min(value, results.get(name, value))
+    return results
+
+
+def revision():
+    try:
+        return subprocess.check_output(["git", "rev-parse", "--short", "HEAD"],
+                                       stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def read_rows(path):
+    if not os.path.exists(path):
+        return None
+    with open(path, newline="") as source:
+        reader = csv.DictReader(source)
+        return reader.fieldnames, list(reader)
+
+
+def load_history(path):
+    """Return {name: [us per item of passed results, oldest first]}."""
+    history = {}
+    rows = read_rows(path)
+    if rows is None:
+        return history
+    for row in rows[1]:
+        # Histories written before the status column only hold passed runs
+        if row.get("status") in (None, PASSED):
+            history.setdefault(row["benchmark"], []).append(float(row["us_per_item"]))
+    return history
+
+
+def append_history(path, results, statuses):
+    rows = read_rows(path)
+    if rows is not None and rows[0] != COLUMNS:
+        # Add the status column to an older history
+        with open(path, "w", newline="") as output:
+            writer = csv.DictWriter(output, COLUMNS, extrasaction="ignore")
+            writer.writeheader()
+            for row in rows[1]:
+                row.setdefault("status", PASSED)
+                writer.writerow(row)
+    new_file = not os.path.exists(path)
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    date = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+    rev = revision()
+    with open(path, "a", newline="") as output:
+        writer = csv.writer(output)
+        if new_file:
+            writer.writerow(COLUMNS)
+        for name, value in results.items():
+            writer.writerow([date, rev, name, "%.4f" % value, statuses[name]])
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--history", default="bench_history.csv")
+    parser.add_argument("--threshold", type=float, default=25.0)
+    parser.add_argument("--runs", type=int, default=5,
+                        help="earlier runs the baseline is the median of")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="benchmark runs, the fastest result of each counts")
+    parser.add_argument("--min-delta", type=float, default=0.01)
+    parser.add_argument("--no-fail", action="store_true",
+                        help="report regressions but exit 0")
+    parser.add_argument("--accept", action="store_true",
+                        help="record regressed results as passed, making them the new baseline")
+    parser.add_argument("--parse", metavar="OUTPUT", action="append",
+                        help="read results from a saved benchmark output")
+    parser.add_argument("command", nargs=argparse.REMAINDER)
+    args = parser.parse_args(argv[1:])
+
+    results = {}
+    passed = True
+    if args.parse:
+        for path in args.parse:
+            with open(path) as source:
+                parse(source.read(), results)
+    elif args.command:
+        for repeat in range(max(args.repeat, 1)):
+            run = subprocess.run(args.command, stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT)
+            output = run.stdout.decode(errors="replace")
+            if repeat == 0:
+                sys.stdout.write(output)
+            passed = passed and run.returncode == 0
+            parse(output, results)
+    else:
+        parser.print_usage(sys.stderr)
+        return 2
+
+    if not results:
+        sys.stderr.write("no benchmark results found\n")
+        return 1
+
+    history = load_history(args.history)
+    regressions = 0
+    statuses = {}
+    print("\n%-56s %10s %10s %8s" % ("benchmark", "baseline", "now", "change"))
+    for name, value in results.items():
+        statuses[name] = PASSED if passed else "failed"
+        earlier = history.get(name, [])[-args.runs:]
+        if not earlier:
+            print("%-56s %10s %10.3f %8s" % (name, "-", value, "new"))
+            continue
+        baseline = statistics.median(earlier)
+        change = (value - baseline) * 100.0 / baseline if baseline > 0 else 0.0
+        flag = ""
+        if change > args.threshold and value - baseline > args.min_delta:
+            flag = "  REGRESSION"
+            regressions += 1
+            if passed and not args.accept:
+                statuses[name] = "regressed"
+        print("%-56s %10.3f %10.3f %+7.1f%%%s" % (name, baseline, value, change, flag))
+
+    append_history(args.history, results, statuses)
+    print("\n%d results appended to %s, %d regressions" % (len(results), args.history, regressions))
+
+    if not passed:
+        return 1
+    return 1 if regressions and not args.no_fail else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
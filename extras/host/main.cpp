@@ -0,0 +1,14 @@
+// Entry point for host builds of the Arduino-style test sketches.
+#include <Arduino.h>
+#include "unity.h"
+
+void setup();
+void loop();
+
+int main() {
+#ifdef TFLUNA_HOST_REAL_TIME
+    hostClockUseRealTime(true);
+#endif
+    setup();
+    return Unity.failures == 0 ? 0 : 1;
+}
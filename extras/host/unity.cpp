@@ -0,0 +1,35 @@
+#include "unity.h"
+
+UnityState Unity = {0, 0, 0, "" };
+
+int hostUnityBegin() {
+    Unity.tests = 0;
+    Unity.failures = 0;
+    return 0;
+}
+
+int hostUnityEnd() {
+    printf("\n-----------------------\n%d Tests %d Failures 0 Ignored\n%s\n",
+           Unity.tests, Unity.failures, Unity.failures ? "FAIL" : "OK");
+    return Unity.failures;
+}
+
+void hostUnityRun(void (*test)(void), const char* name, int line) {
+    Unity.tests++;
+    Unity.currentFailed = 0;
+    Unity.currentName = name;
+    test();
+    if (!Unity.currentFailed) {
+        printf("test:%d:%s:PASS\n", line, name);
+    }
+}
+
+void hostUnityFail(const char* message, int line) {
+    Unity.currentFailed = 1;
+    Unity.failures++;
+    printf("test:%d:%s:FAIL: %s\n", line, Unity.currentName, message);
+}
+
+void hostUnityMessage(const char* message, int line) {
+    printf("test:%d:%s:INFO: %s\n", line, Unity.currentName, message);
+}
@@ -0,0 +1,72 @@
+// Minimal subset of the Unity test framework API used by the test sketches.
+#ifndef TFLUNA_HOST_UNITY_H
+#define TFLUNA_HOST_UNITY_H
+
+#include <stdio.h>
+#include <math.h>
+
+struct UnityState {
+    int tests;
+    int failures;
+    int currentFailed;
+    const char* currentName;
+};
+extern UnityState Unity;
+
+int hostUnityBegin();
+int hostUnityEnd();
+void hostUnityRun(void (*test)(void), const char* name, int line);
+void hostUnityFail(const char* message, int line);
+void hostUnityMessage(const char* message, int line);
+
+#define UNITY_BEGIN() hostUnityBegin()
+#define UNITY_END() hostUnityEnd()
+#define RUN_TEST(fn) hostUnityRun(fn, #fn, __LINE__)
+
+#define UNITY_TEST_ASSERT(cond, line, msg) \
+    do { if (!(cond)) { hostUnityFail(msg, line); return; } } while (0)
+
+#define TEST_ASSERT(cond) UNITY_TEST_ASSERT((cond), __LINE__, #cond)
+#define TEST_ASSERT_TRUE(cond) UNITY_TEST_ASSERT((cond), __LINE__, "Expected TRUE: " #cond)
+#define TEST_ASSERT_FALSE(cond) UNITY_TEST_ASSERT(!(cond), __LINE__, "Expected FALSE: " #cond)
+#define TEST_ASSERT_NULL(p) UNITY_TEST_ASSERT((p) == NULL, __LINE__, "Expected NULL: " #p)
+#define TEST_ASSERT_NOT_NULL(p) UNITY_TEST_ASSERT((p) != NULL, __LINE__, "Expected non-NULL: " #p)
+#define TEST_ASSERT_EQUAL(e, a) \
+    UNITY_TEST_ASSERT((long long)(e) == (long long)(a), __LINE__, "Expected " #e " == " #a)
+#define TEST_ASSERT_EQUAL_INT(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_UINT(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_UINT8(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_UINT16(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_UINT32(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_INT16(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_INT32(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_EQUAL_HEX8(e, a) TEST_ASSERT_EQUAL(e, a)
+#define TEST_ASSERT_NOT_EQUAL(e, a) \
+    UNITY_TEST_ASSERT((long long)(e) != (long long)(a), __LINE__, "Expected " #e " != " #a)
+#define TEST_ASSERT_LESS_THAN(t, a) \
+    UNITY_TEST_ASSERT((long long)(a) < (long long)(t), __LINE__, "Expected " #a " < " #t)
+#define TEST_ASSERT_GREATER_THAN(t, a) \
+    UNITY_TEST_ASSERT((long long)(a) > (long long)(t), __LINE__, "Expected " #a " > " #t)
+#define TEST_ASSERT_LESS_OR_EQUAL(t, a) \
+    UNITY_TEST_ASSERT((long long)(a) <= (long long)(t), __LINE__, "Expected " #a " <= " #t)
+#define TEST_ASSERT_GREATER_OR_EQUAL(t, a) \
+    UNITY_TEST_ASSERT((long long)(a) >= (long long)(t), __LINE__, "Expected " #a " >= " #t)
+#define TEST_ASSERT_UINT_WITHIN(d, e, a) \
+    do { long long unity_a = (long long)(a); long long unity_e = (long long)(e); \
+         UNITY_TEST_ASSERT(unity_a - unity_e <= (long long)(d) && \
+                           unity_e - unity_a <= (long long)(d), __LINE__, \
+                           "Expected " #a " within " #d " of " #e); } while (0)
+#define TEST_ASSERT_INT_WITHIN(d, e, a) TEST_ASSERT_UINT_WITHIN(d, e, a)
+#define TEST_ASSERT_UINT32_WITHIN(d, e, a) TEST_ASSERT_UINT_WITHIN(d, e, a)
+#define TEST_ASSERT_FLOAT_WITHIN(d, e, a) \
+    do { double unity_a = (double)(a); \
+         UNITY_TEST_ASSERT(fabs(unity_a - (double)(e)) <= (double)(d), __LINE__, \
+                           "Expected " #a " within " #d " of " #e); } while (0)
+#define TEST_ASSERT_DOUBLE_WITHIN(d, e, a) TEST_ASSERT_FLOAT_WITHIN(d, e, a)
+#define TEST_ASSERT_EQUAL_MEMORY(e, a, n) \
+    UNITY_TEST_ASSERT(memcmp((e), (a), (n)) == 0, __LINE__, "Memory mismatch")
+#define TEST_FAIL_MESSAGE(msg) do { hostUnityFail(msg, __LINE__); return; } while (0)
+#define TEST_MESSAGE(msg) hostUnityMessage(msg, __LINE__)
+#define TEST_IGNORE() return
+
+#endif // TFLUNA_HOST_UNITY_H
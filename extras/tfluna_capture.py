@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Inspect a raw UART capture written by TFLunaRecorder.
+
+A capture is a 9-byte header followed by one record per burst of bytes:
+
+    "TFLC"                     magic
+    uint8  version             1
+    uint32 baud rate           little-endian
+
+    varint time                us since the previous chunk (LEB128)
+    uint8  count               1-255
+    count bytes                as read by the parser
+
+Usage:
+    tfluna_capture.py dump capture.bin       chunk times and bytes as text
+    tfluna_capture.py raw capture.bin out    the bytes alone, without times
+"""
+
+import struct
+import sys
+
+MAGIC = b"TFLC"
+HEADER = struct.Struct("<4sBI")
+
+
+def read_chunks(data):
+    """Return the baud rate, the chunks as (time_us, bytes) and whether the
+    capture ends inside a chunk."""
+    magic, version, baud = HEADER.unpack_from(data)
+    if magic != MAGIC or version != 1:
+        raise ValueError("not a TFLuna capture")
+
+    chunks = []
+    index = HEADER.size
+    time = 0
+    while index < len(data):
+        delta = 0
+        shift = 0
+        while True:
+            if index >= len(data) or shift > 28:
+                return baud, chunks, True
+            byte = data[index]
+            index += 1
+            delta |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                break
+            shift += 7
+
+        if index >= len(data) or data[index] == 0 or index + 1 + data[index] > len(data):
+            return baud, chunks, True
+        count = data[index]
+        time += delta
+        chunks.append((time, data[index + 1:index + 1 + count]))
+        index += 1 + count
+
+    return baud, chunks, False
+
+
+def main(argv):
+    if len(argv) < 3 or argv[1] not in ("dump", "raw") or (argv[1] == "raw") != (len(argv) == 4):
+        sys.stderr.write(__doc__)
+        return 2
+
+    with open(argv[2], "rb") as source:
+        baud, chunks, truncated = read_chunks(source.read())
+
+    if argv[1] == "dump":
+        for time, chunk in chunks:
+            print("%12d  %s" % (time, chunk.hex(" ")))
+    else:
+        with open(argv[3], "wb") as output:
+            for _, chunk in chunks:
+                output.write(chunk)
+
+    total = sum(len(chunk) for _, chunk in chunks)
+    duration = chunks[-1][0] / 1e6 if chunks else 0.0
+    sys.stderr.write("%d baud, %d chunks, %d bytes over %.3f s%s\n"
+                     % (baud, len(chunks), total, duration,
+                        ", truncated" if truncated else ""))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
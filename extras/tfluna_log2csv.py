@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Convert a binary TFLuna log (TFLUNA_LOG_BINARY) to CSV.
+
+Each record is 21 bytes, little-endian:
+
+    0xA5 0x5A                 sync
+    uint16 distance           cm, or mm when unit is 1
+    uint16 strength
+    int16  temperature        0.01 degC
+    uint16 device tick        I2C register 0x06, 0 for UART
+    uint32 host micros
+    uint32 sequence
+    uint8  unit               0 cm, 1 mm (output format)
+    uint8  error code         TFLUNA_OK (0) or TFLUNA_ERROR_*
+    uint8  checksum           low byte of the sum of the 20 bytes before it
+
+Bytes that do not form a valid record (for example text printed on the same
+serial port) are skipped, and decoding resynchronises on the next sync pair.
+
+Usage:
+    tfluna_log2csv.py capture.bin [output.csv]
+"""
+
+import csv
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+RECORD = struct.Struct("<2sHHhHIIBBB")
+
+COLUMNS = ["sequence", "host_micros", "device_tick", "distance_mm",
+           "strength", "temperature_c", "error_code"]
+
+# Millimetres per distance unit
+UNIT_SCALE = {0: 10, 1: 1}
+
+
+def decode(data):
+    """Return the valid records and the number of bytes skipped."""
+    skipped = 0
+    index = 0
+    records = []
+
+    while index + RECORD.size <= len(data):
+        if data[index:index + 2] != SYNC:
+            index += 1
+            skipped += 1
+            continue
+
+        chunk = data[index:index + RECORD.size]
+        if sum(chunk[:-1]) & 0xFF != chunk[-1]:
+            index += 1
+            skipped += 1
+            continue
+
+        (_, distance, strength, temperature, tick, micros,
+         sequence, unit, error, _) = RECORD.unpack(chunk)
+        if unit not in UNIT_SCALE:
+            index += 1
+            skipped += 1
+            continue
+        records.append((sequence, micros, tick, distance * UNIT_SCALE[unit], strength,
+                        "%.2f" % (temperature / 100.0), error))
+        index += RECORD.size
+
+    skipped += len(data) - index
+    return records, skipped
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write(__doc__)
+        return 2
+
+    with open(argv[1], "rb") as source:
+        records, skipped = decode(source.read())
+
+    output = open(argv[2], "w", newline="") if len(argv) == 3 else sys.stdout
+    try:
+        writer = csv.writer(output)
+        writer.writerow(COLUMNS)
+        writer.writerows(records)
+    finally:
+        if output is not sys.stdout:
+            output.close()
+
+    # Gaps in the sequence are frames the sensor sent but the log never got
+    lost = 0
+    for previous, current in zip(records, records[1:]):
+        if current[0] > previous[0] + 1:
+            lost += current[0] - previous[0] - 1
+
+    sys.stderr.write("%d records, %d bytes skipped, %d frames missing\n"
+                     % (len(records), skipped, lost))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
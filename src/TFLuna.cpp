@@ -1,9 +1,42 @@
 #include "TFLuna.h"
 
+#if TFLUNA_LATENCY_HISTOGRAM
+// Records the time from its construction to the end of the enclosing block,
+// whichever return leaves it
+class TFLunaLatencyScope {
+public:
+    TFLunaLatencyScope(TFLunaLatencyHistogram &histogram) : _histogram(histogram), _start(micros()) {}
+    ~TFLunaLatencyScope() {
+        _histogram.record(micros() - _start);
+    }
+
+private:
+    TFLunaLatencyHistogram &_histogram;
+    uint32_t _start;
+};
+#define TFLUNA_TIME_BLOCK(phase) TFLunaLatencyScope latencyScope(_latency[phase])
+#else
+#define TFLUNA_TIME_BLOCK(phase)
+#endif
+
 // Constructors
 TFLuna::TFLuna() {
     _mode = TFLUNA_I2C_MODE;
+    _wire = &Wire;
+    _stream = NULL;
+    _serial = NULL;
+    _ownSerial = false;
+    _distance = 0;
+    _strength = 0;
+    _temperature = 0;
+    _errorCode = TFLUNA_OK;
+}
+
+TFLuna::TFLuna(TwoWire* wire) {
+    _mode = TFLUNA_I2C_MODE;
+    _wire = wire;
     _stream = NULL;
+    _serial = NULL;
     _ownSerial = false;
     _distance = 0;
     _strength = 0;
@@ -13,7 +46,9 @@ TFLuna::TFLuna() {
 
 TFLuna::TFLuna(HardwareSerial* serial) {
     _mode = TFLUNA_UART_MODE;
+    _wire = &Wire;
     _stream = serial;
+    _serial = serial;
     _ownSerial = false;
     _distance = 0;
     _strength = 0;
@@ -23,7 +58,9 @@ TFLuna::TFLuna(HardwareSerial* serial) {
 
 TFLuna::TFLuna(Stream* stream) {
     _mode = TFLUNA_UART_MODE;
+    _wire = &Wire;
     _stream = stream;
+    _serial = NULL;
     _ownSerial = false;
     _distance = 0;
     _strength = 0;
@@ -39,29 +76,37 @@ bool TFLuna::begin(uint32_t baudRate) {
     }
     
     // If using HardwareSerial, initialize it
-    HardwareSerial* serial = dynamic_cast<HardwareSerial*>(_stream);
-    if (serial != NULL) {
-        serial->begin(baudRate);
-        delay(100); // Give some time to initialize
+    if (_serial != NULL) {
+        _serial->begin(baudRate);
     }
+    _baudRate = baudRate;
+    _savedBaud = baudRate;  // The rate the sensor starts with
     
     // Clear any existing data
     while (_stream->available()) {
         _stream->read();
     }
+    _resetParser();
     
+    // Wait for the first frame instead of a fixed boot delay. A sensor with
+    // its output disabled never sends one, so missing the deadline only
+    // leaves TFLUNA_ERROR_TIMEOUT in getErrorCode(); the port is usable.
+    _startReady(0, 0, TFLUNA_BOOT_TIMEOUT_MS, false);
+    waitReady();
     return true;
 }
 
-bool TFLuna::beginI2C() {
+bool TFLuna::beginI2C(uint8_t addr) {
     _mode = TFLUNA_I2C_MODE;
-    Wire.begin();
-    delay(100); // Give some time to initialize
-    return true;
+    _wire->begin();
+    
+    _startReady(addr, 0, TFLUNA_BOOT_TIMEOUT_MS, true);
+    return waitReady();
 }
 
 // Data acquisition
 bool TFLuna::getData() {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_CALL);
     if (_mode != TFLUNA_UART_MODE || _stream == NULL) {
         _errorCode = TFLUNA_ERROR_SERIAL;
         return false;
@@ -71,6 +116,7 @@ bool TFLuna::getData() {
 }
 
 bool TFLuna::getDataI2C(uint8_t addr) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_CALL);
     if (_mode != TFLUNA_I2C_MODE) {
         _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
@@ -79,11 +125,232 @@ bool TFLuna::getDataI2C(uint8_t addr) {
     return _readData(addr);
 }
 
+// Timestamped acquisition
+bool TFLuna::read(Sample &sample, uint8_t addr) {
+    bool result = (_mode == TFLUNA_I2C_MODE) ? getDataI2C(addr) : getData();
+    if (result) {
+        getSample(sample);
+    }
+    return result;
+}
+
+void TFLuna::getSample(Sample &sample) const {
+    sample.distance = _distance;
+    sample.strength = _strength;
+    sample.temperature = _temperature;
+    sample.timestamp = _timestamp;
+    sample.hostMicros = _sampleMicros;
+    sample.sequence = _sequence;
+    sample.unit = _unit;
+}
+
+// Non-blocking UART acquisition
+bool TFLuna::poll() {
+    if (_stream == NULL) {
+        _errorCode = TFLUNA_ERROR_SERIAL;
+        return false;
+    }
+    
+    serviceCommands();
+    
+    // Only consume what is already buffered; stop as soon as a frame completes
+    // so the caller can pick it up before the next one overwrites it
+    while (_stream->available() > 0) {
+        int byte = _stream->read();
+        if (byte < 0) {
+            break;
+        }
+        if (feed((uint8_t)byte)) {
+            return true;
+        }
+    }
+    
+    // A reply may have finished a command, send the next one
+    serviceCommands();
+    return false;
+}
+
+bool TFLuna::feed(uint8_t byte) {
+    switch (_parseState) {
+        case TFLUNA_PARSE_HEADER1:
+            if (byte == TFLUNA_FRAME_HEADER) {
+                _frameBuffer[0] = byte;
+                _parseState = TFLUNA_PARSE_HEADER2;
+            } else if (byte == TFLUNA_CMD_HEADER) {
+                _frameBuffer[0] = byte;
+                _parseState = TFLUNA_PARSE_REPLY_LENGTH;
+            } else {
+                _stats.bytesDiscarded++;
+            }
+            return false;
+        
+        case TFLUNA_PARSE_REPLY_LENGTH:
+            if (byte < TFLUNA_CMD_MIN_LENGTH || byte > TFLUNA_CMD_MAX_LENGTH) {
+                // Not a reply after all; the byte may start a data frame or
+                // another reply
+                bool header = (byte == TFLUNA_FRAME_HEADER || byte == TFLUNA_CMD_HEADER);
+                if (byte == TFLUNA_FRAME_HEADER) {
+                    _parseState = TFLUNA_PARSE_HEADER2;
+                } else if (byte != TFLUNA_CMD_HEADER) {
+                    _parseState = TFLUNA_PARSE_HEADER1;
+                }
+                _frameBuffer[0] = byte;
+                _stats.headerErrors++;
+                _stats.bytesDiscarded += header ? 1 : 2;
+                return false;
+            }
+            _frameBuffer[1] = byte;
+            _frameLength = byte;
+            _frameIndex = 2;
+            _parseState = TFLUNA_PARSE_REPLY;
+            return false;
+        
+        case TFLUNA_PARSE_REPLY:
+            _frameBuffer[_frameIndex++] = byte;
+            if (_frameIndex < _frameLength) {
+                return false;
+            }
+            
+            // Command replies complete commands, they are not measurements
+            _resetParser();
+            if (_calculateChecksum(_frameBuffer, _frameLength - 1) == _frameBuffer[_frameLength - 1]) {
+                _handleReply(_frameBuffer, _frameLength);
+            } else {
+                _stats.checksumErrors++;
+            }
+            return false;
+        
+        case TFLUNA_PARSE_HEADER2:
+            if (byte == TFLUNA_FRAME_HEADER) {
+                _frameBuffer[1] = byte;
+                _frameIndex = 2;
+                _parseState = TFLUNA_PARSE_PAYLOAD;
+#if TFLUNA_LATENCY_HISTOGRAM
+                _headerMicros = micros();
+#endif
+            } else if (byte == TFLUNA_CMD_HEADER) {
+                // A stray frame header, then a reply
+                _frameBuffer[0] = byte;
+                _parseState = TFLUNA_PARSE_REPLY_LENGTH;
+                _stats.headerErrors++;
+                _stats.bytesDiscarded++;
+            } else {
+                _parseState = TFLUNA_PARSE_HEADER1; // Need consecutive header bytes
+                _stats.headerErrors++;
+                _stats.bytesDiscarded += 2;
+            }
+            return false;
+        
+        default:
+            _frameBuffer[_frameIndex++] = byte;
+            if (_frameIndex < TFLUNA_FRAME_LENGTH) {
+                return false;
+            }
+            break;
+    }
+    
+    // Full frame received, look for the next header from here on
+    _parseState = TFLUNA_PARSE_HEADER1;
+    _frameIndex = 0;
+    _sequence++; // Counted even when rejected so consumers can see the gap
+    
+    // Verify checksum
+    uint8_t checksum = _calculateChecksum(_frameBuffer, TFLUNA_FRAME_LENGTH - 1);
+    if (checksum != _frameBuffer[TFLUNA_FRAME_LENGTH - 1]) {
+        _stats.checksumErrors++;
+        _errorCode = TFLUNA_ERROR_CHECKSUM;
+        return false;
+    }
+    
+    // Parse data
+    Sample sample;
+    _decodeFrame(_frameBuffer, sample);
+    _distance = sample.distance;
+    _strength = sample.strength;
+    _temperature = sample.temperature;
+    _timestamp = 0;
+    _sampleMicros = micros();
+    _stats.framesOk++;
+    
+    _errorCode = TFLUNA_OK;
+    return true;
+}
+
+size_t TFLuna::decodeFrames(const uint8_t* data, size_t length,
+                            Sample* samples, size_t maxSamples,
+                            size_t &consumed, size_t &dropped) {
+    size_t count = 0;
+    size_t i = 0;
+    uint32_t now = micros(); // One clock read for the whole batch
+    dropped = 0;
+    
+    while (i < length && count < maxSamples) {
+        // Fast path: a whole frame is aligned in the buffer and no partial
+        // frame is pending, so decode it in place without the state machine
+        if (_parseState == TFLUNA_PARSE_HEADER1 &&
+            length - i >= TFLUNA_FRAME_LENGTH &&
+            data[i] == TFLUNA_FRAME_HEADER &&
+            data[i + 1] == TFLUNA_FRAME_HEADER) {
+            const uint8_t* frame = data + i;
+            i += TFLUNA_FRAME_LENGTH;
+            _sequence++;
+            
+            uint8_t checksum = 0;
+            for (uint8_t j = 0; j < TFLUNA_FRAME_LENGTH - 1; j++) {
+                checksum += frame[j];
+            }
+            if (checksum != frame[TFLUNA_FRAME_LENGTH - 1]) {
+                dropped++;
+                _stats.checksumErrors++;
+                continue;
+            }
+            
+            _decodeFrame(frame, samples[count]);
+            samples[count].hostMicros = now;
+            samples[count].sequence = _sequence;
+            _stats.framesOk++;
+            count++;
+            continue;
+        }
+        
+        // Slow path: resynchronise or finish a frame carried over from the
+        // previous call one byte at a time
+        bool completing = (_parseState == TFLUNA_PARSE_PAYLOAD &&
+                           _frameIndex == TFLUNA_FRAME_LENGTH - 1);
+        if (feed(data[i++])) {
+            getSample(samples[count]);
+            count++;
+        } else if (completing) {
+            dropped++;
+        }
+    }
+    
+    consumed = i;
+    
+    // Keep the single-value accessors in step with the newest frame
+    if (count > 0) {
+        _distance = samples[count - 1].distance;
+        _strength = samples[count - 1].strength;
+        _temperature = samples[count - 1].temperature;
+        _timestamp = 0;
+        _sampleMicros = samples[count - 1].hostMicros;
+        _errorCode = TFLUNA_OK;
+    } else if (dropped > 0) {
+        _errorCode = TFLUNA_ERROR_CHECKSUM;
+    }
+    
+    return count;
+}
+
 // Data accessors
 uint16_t TFLuna::getDistance() const {
     return _distance;
 }
 
+uint8_t TFLuna::getDistanceUnit() const {
+    return _unit;
+}
+
 uint16_t TFLuna::getSignalStrength() const {
     return _strength;
 }
@@ -96,49 +363,406 @@ uint8_t TFLuna::getErrorCode() const {
     return _errorCode;
 }
 
+uint8_t TFLuna::getMode() const {
+    return _mode;
+}
+
+uint16_t TFLuna::getTimestamp() const {
+    return _timestamp;
+}
+
+// Bus statistics (I2C)
+TwoWire* TFLuna::getWire() const {
+    return _wire;
+}
+
+uint32_t TFLuna::getBusTransactions() const {
+    return _busTransactions;
+}
+
+void TFLuna::resetBusTransactions() {
+    _busTransactions = 0;
+}
+
+// Acquisition statistics
+void TFLuna::getStatistics(Statistics &stats) const {
+    stats = _stats;
+}
+
+void TFLuna::resetStatistics() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+#if TFLUNA_LATENCY_HISTOGRAM
+// Latency histograms
+const TFLunaLatencyHistogram& TFLuna::getLatencyHistogram(uint8_t phase) const {
+    return _latency[phase < TFLUNA_LATENCY_PHASES ? phase : TFLUNA_LATENCY_CALL];
+}
+
+uint32_t TFLuna::getLatencyPercentile(uint8_t phase, uint8_t percent) const {
+    if (phase >= TFLUNA_LATENCY_PHASES) {
+        return 0;
+    }
+    return _latency[phase].getPercentile(percent);
+}
+
+void TFLuna::resetLatency() {
+    for (uint8_t i = 0; i < TFLUNA_LATENCY_PHASES; i++) {
+        _latency[i].reset();
+    }
+}
+#endif
+
+// Asynchronous commands (UART)
+uint8_t TFLuna::queueCommand(uint8_t command, const uint8_t* payload, uint8_t payloadLen,
+                             CommandCallback callback) {
+    if (_mode != TFLUNA_UART_MODE || _stream == NULL) {
+        _errorCode = TFLUNA_ERROR_SERIAL;
+        return 0;
+    }
+    
+    if (payloadLen > TFLUNA_CMD_MAX_PAYLOAD || (payloadLen > 0 && payload == NULL)) {
+        _errorCode = TFLUNA_ERROR_INVALID_PARAM;
+        return 0;
+    }
+    
+    if (_commandCount >= TFLUNA_CMD_QUEUE_LENGTH) {
+        _errorCode = TFLUNA_ERROR_BUSY;
+        return 0;
+    }
+    
+    Command &slot = _commands[(_commandHead + _commandCount) % TFLUNA_CMD_QUEUE_LENGTH];
+    slot.ticket = _nextTicket;
+    slot.id = command;
+    if (payloadLen > 0) {
+        memcpy(slot.payload, payload, payloadLen);
+    }
+    slot.payloadLen = payloadLen;
+    slot.status = TFLUNA_CMD_QUEUED;
+    slot.errorCode = TFLUNA_OK;
+    slot.callback = callback;
+    _commandCount++;
+    _nextTicket = (_nextTicket == 0xFF) ? 1 : _nextTicket + 1;
+    
+    // Goes out right away when no other command is waiting for its reply
+    serviceCommands();
+    return slot.ticket;
+}
+
+uint8_t TFLuna::getCommandStatus(uint8_t ticket) const {
+    const Command* command = _findCommand(ticket);
+    return command != NULL ? command->status : TFLUNA_CMD_UNKNOWN;
+}
+
+uint8_t TFLuna::getCommandError(uint8_t ticket) const {
+    const Command* command = _findCommand(ticket);
+    return command != NULL ? command->errorCode : TFLUNA_ERROR_INVALID_PARAM;
+}
+
+bool TFLuna::isCommandPending() const {
+    return _commandCount > 0;
+}
+
+void TFLuna::serviceCommands() {
+    while (_commandCount > 0 && _stream != NULL) {
+        Command &command = _commands[_commandHead];
+        
+        if (command.status == TFLUNA_CMD_QUEUED) {
+            uint8_t buffer[TFLUNA_CMD_MAX_LENGTH];
+            uint8_t length = command.payloadLen + TFLUNA_CMD_MIN_LENGTH;
+            buffer[0] = TFLUNA_CMD_HEADER;
+            buffer[1] = length;
+            buffer[2] = command.id;
+            memcpy(&buffer[3], command.payload, command.payloadLen);
+            buffer[length - 1] = _calculateChecksum(buffer, length - 1);
+            
+            _stream->write(buffer, length);
+            command.status = TFLUNA_CMD_SENT;
+            command.sentMillis = millis();
+            
+            // A trigger is answered by a data frame, not by a reply
+            if (command.id != TFLUNA_CMD_TRIGGER) {
+                break;
+            }
+            _finishCommand(TFLUNA_OK);
+        } else if (millis() - command.sentMillis > TFLUNA_CMD_TIMEOUT_MS) {
+            _finishCommand(TFLUNA_ERROR_TIMEOUT);
+        } else {
+            break;
+        }
+    }
+}
+
+// Readiness
+bool TFLuna::startSoftReset() {
+    uint8_t ticket = queueCommand(TFLUNA_CMD_SOFT_RESET);
+    if (ticket == 0) {
+        return false;
+    }
+    
+    _startReady(0, ticket, TFLUNA_RESET_TIMEOUT_MS, false);
+    return true;
+}
+
+bool TFLuna::startHardReset() {
+    // Restores the factory settings, then restarts
+    uint8_t ticket = queueCommand(TFLUNA_CMD_FACTORY_RESET);
+    if (ticket == 0) {
+        return false;
+    }
+    
+    _startReady(0, ticket, TFLUNA_RESET_TIMEOUT_MS, false);
+    return true;
+}
+
+bool TFLuna::startSoftResetI2C(uint8_t addr) {
+    return _startResetI2C(0x02, addr, addr);
+}
+
+bool TFLuna::startHardResetI2C(uint8_t addr) {
+    return _startResetI2C(0x01, addr, addr);
+}
+
+bool TFLuna::startSaveSettingsI2C(uint8_t addr) {
+    if (!_writeRegister(TFLUNA_I2C_SAVE_SETTINGS, 0x01, addr)) {
+        return false;
+    }
+    
+    // The device does not answer while it writes its flash
+    _startReady(addr, 0, TFLUNA_SAVE_TIMEOUT_MS, false);
+    return true;
+}
+
+uint8_t TFLuna::pollReady() {
+    if (_readyState != TFLUNA_READY_WAITING) {
+        return _readyState;
+    }
+    
+    uint32_t now = millis();
+    if (_mode == TFLUNA_UART_MODE) {
+        if (_readyTicket != 0) {
+            // Frames still count from before the reset until its reply arrives
+            poll();
+            uint8_t status = getCommandStatus(_readyTicket);
+            if (status == TFLUNA_CMD_DONE) {
+                // The sensor restarts with its saved settings, or the factory ones
+                const Command* command = _findCommand(_readyTicket);
+                _readyTicket = 0;
+                _readyProbe = now;
+                if (!_restoreSettings(command != NULL && command->id == TFLUNA_CMD_FACTORY_RESET)) {
+                    _readyState = TFLUNA_READY_FAILED;
+                    return _readyState;
+                }
+            } else if (status != TFLUNA_CMD_QUEUED && status != TFLUNA_CMD_SENT) {
+                _errorCode = getCommandError(_readyTicket);
+                _readyState = TFLUNA_READY_FAILED;
+                return _readyState;
+            }
+        } else if (poll()) {
+            _errorCode = TFLUNA_OK;
+            _readyState = TFLUNA_READY_OK;
+            return _readyState;
+        } else if (now - _readyProbe >= _readyInterval) {
+            // A sensor in trigger mode only sends frames on request. One in
+            // continuous mode may just be between frames, so back off rather
+            // than trigger it every interval.
+            _readyProbe = now;
+            if (_readyInterval < TFLUNA_READY_TRIGGER_MAX_MS) {
+                _readyInterval *= 2;
+            }
+            queueCommand(TFLUNA_CMD_TRIGGER);
+        }
+    } else if (now - _readyProbe >= TFLUNA_READY_POLL_MS) {
+        _readyProbe = now;
+        if (pingI2C(_readyAddr)) {
+            _readyState = TFLUNA_READY_OK;
+            return _readyState;
+        }
+    }
+    
+    if (now - _readyStart >= _readyTimeout) {
+        _errorCode = TFLUNA_ERROR_TIMEOUT;
+        _readyState = TFLUNA_READY_FAILED;
+    }
+    return _readyState;
+}
+
+bool TFLuna::waitReady() {
+    uint8_t state = pollReady();
+    while (state == TFLUNA_READY_WAITING) {
+        state = pollReady();
+    }
+    return state != TFLUNA_READY_FAILED;
+}
+
+bool TFLuna::pingI2C(uint8_t addr) {
+    // No answer is expected while the device restarts, not a bus error
+    Statistics stats = _stats;
+    uint8_t value;
+    bool answered = _readRegister(TFLUNA_I2C_FIRMWARE_L, value, addr);
+    _stats = stats;
+    return answered;
+}
+
+// Baud rate (UART)
+static const uint32_t baudRates[TFLUNA_BAUD_COUNT] = {
+    115200, 9600, 14400, 19200, 38400, 56000, 57600,
+    128000, 230400, 256000, 460800, 500000, 512000, 921600
+};
+
+bool TFLuna::setBaudRate(uint32_t baudRate) {
+    if (!isSupportedBaudRate(baudRate)) {
+        _errorCode = TFLUNA_ERROR_INVALID_PARAM;
+        return false;
+    }
+    
+    // Once the sensor switches there is no way back if the port cannot follow
+    if (_mode != TFLUNA_UART_MODE || _stream == NULL || !_canSetPortBaud()) {
+        _errorCode = TFLUNA_ERROR_SERIAL;
+        return false;
+    }
+    
+    // The echo still comes at the old rate, the sensor switches after it
+    uint8_t payload[4];
+    payload[0] = baudRate & 0xFF;
+    payload[1] = (baudRate >> 8) & 0xFF;
+    payload[2] = (baudRate >> 16) & 0xFF;
+    payload[3] = (baudRate >> 24) & 0xFF;
+    if (!_sendCommand(TFLUNA_CMD_BAUD_RATE, payload, 4)) {
+        return false;
+    }
+    
+    uint32_t oldBaud = _baudRate;
+    if (!_openPort(baudRate)) {
+        return false;
+    }
+    if (_verifyBaud(TFLUNA_BAUD_VERIFY_MS)) {
+        return true;
+    }
+    
+    // No frames at the new rate: the sensor kept the old one
+    _openPort(oldBaud);
+    _verifyBaud(TFLUNA_BAUD_VERIFY_MS);
+    _errorCode = TFLUNA_ERROR_COMMAND;
+    return false;
+}
+
+uint32_t TFLuna::detectBaudRate() {
+    if (_mode != TFLUNA_UART_MODE || _stream == NULL) {
+        _errorCode = TFLUNA_ERROR_SERIAL;
+        return 0;
+    }
+    
+    // The rate in use first, then the others, the default among the first
+    uint32_t current = _baudRate;
+    for (int8_t i = -1; i < TFLUNA_BAUD_COUNT; i++) {
+        uint32_t candidate = (i < 0) ? current : baudRates[i];
+        if (i >= 0 && candidate == current) {
+            continue;
+        }
+        
+        if (!_openPort(candidate)) {
+            return 0;
+        }
+        if (_verifyBaud(TFLUNA_BAUD_DETECT_MS)) {
+            _savedBaud = candidate;
+            return candidate;
+        }
+    }
+    
+    _errorCode = TFLUNA_ERROR_TIMEOUT;
+    return 0;
+}
+
+uint32_t TFLuna::getBaudRate() const {
+    return _baudRate;
+}
+
+bool TFLuna::isSupportedBaudRate(uint32_t baudRate) {
+    for (uint8_t i = 0; i < TFLUNA_BAUD_COUNT; i++) {
+        if (baudRates[i] == baudRate) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Configuration methods (UART)
 bool TFLuna::setFrameRate(uint16_t frameRate) {
     uint8_t payload[2];
     payload[0] = frameRate & 0xFF;         // Low byte
     payload[1] = (frameRate >> 8) & 0xFF;  // High byte
     
-    return _sendCommand(0x03, payload, 2);
+    if (!_sendCommand(TFLUNA_CMD_FRAME_RATE, payload, 2)) {
+        return false;
+    }
+    if (frameRate > 0) {
+        _continuousRate = frameRate;
+    }
+    return true;
 }
 
 bool TFLuna::setSaveSettings() {
-    return _sendCommand(0x11);
+    if (!_sendCommand(TFLUNA_CMD_SAVE_SETTINGS)) {
+        return false;
+    }
+    _savedUnit = _unit;
+    _savedRate = _continuousRate;
+    _savedBaud = _baudRate;
+    return true;
 }
 
 bool TFLuna::setSoftReset() {
-    bool result = _sendCommand(0x02);
-    delay(100); // Give time for the device to reset
-    return result;
+    return startSoftReset() && waitReady();
 }
 
 bool TFLuna::setHardReset() {
-    bool result = _sendCommand(0x01);
-    delay(100); // Give time for the device to reset
-    return result;
+    return startHardReset() && waitReady();
 }
 
 bool TFLuna::setTriggerMode() {
-    return _sendCommand(0x04, NULL, 0);
+    // A frame rate of zero stops continuous output; frames come on trigger
+    uint8_t payload[2] = { 0, 0 };
+    return _sendCommand(TFLUNA_CMD_FRAME_RATE, payload, 2);
 }
 
 bool TFLuna::setContinuousMode() {
-    return _sendCommand(0x05, NULL, 0);
+    uint8_t payload[2];
+    payload[0] = _continuousRate & 0xFF;
+    payload[1] = (_continuousRate >> 8) & 0xFF;
+    return _sendCommand(TFLUNA_CMD_FRAME_RATE, payload, 2);
 }
 
 bool TFLuna::triggerSample() {
-    return _sendCommand(0x06, NULL, 0);
+    return _sendCommand(TFLUNA_CMD_TRIGGER);
 }
 
 bool TFLuna::setEnable() {
-    return _sendCommand(0x07, NULL, 0);
+    uint8_t enable = 0x01;
+    return _sendCommand(TFLUNA_CMD_OUTPUT_ENABLE, &enable, 1);
 }
 
 bool TFLuna::setDisable() {
-    return _sendCommand(0x08, NULL, 0);
+    uint8_t enable = 0x00;
+    return _sendCommand(TFLUNA_CMD_OUTPUT_ENABLE, &enable, 1);
+}
+
+bool TFLuna::setOutputFormat(uint8_t format) {
+    if (format != TFLUNA_FORMAT_CM && format != TFLUNA_FORMAT_MM) {
+        _errorCode = TFLUNA_ERROR_INVALID_PARAM;
+        return false;
+    }
+    
+    // Frames after the echo carry the new unit
+    if (!_sendCommand(TFLUNA_CMD_OUTPUT_FORMAT, &format, 1)) {
+        return false;
+    }
+    _unit = (format == TFLUNA_FORMAT_MM) ? TFLUNA_UNIT_MM : TFLUNA_UNIT_CM;
+    return true;
+}
+
+uint8_t TFLuna::getOutputFormat() const {
+    return (_unit == TFLUNA_UNIT_MM) ? TFLUNA_FORMAT_MM : TFLUNA_FORMAT_CM;
 }
 
 // Configuration methods (I2C)
@@ -154,29 +778,24 @@ bool TFLuna::setI2CAddress(uint8_t newAddr, uint8_t currentAddr) {
     
     bool result = _writeRegister(TFLUNA_I2C_SET_I2C_ADDR, newAddr, currentAddr);
     if (result) {
-        // Need to reset for the new address to take effect
-        result = setSoftResetI2C(currentAddr);
+        // Need to reset for the new address to take effect; the device then
+        // answers at the new address
+        result = _startResetI2C(0x02, currentAddr, newAddr) && waitReady();
     }
     
     return result;
 }
 
 bool TFLuna::setSaveSettingsI2C(uint8_t addr) {
-    bool result = _writeRegister(TFLUNA_I2C_SAVE_SETTINGS, 0x01, addr);
-    delay(200); // Save settings can take time
-    return result;
+    return startSaveSettingsI2C(addr) && waitReady();
 }
 
 bool TFLuna::setSoftResetI2C(uint8_t addr) {
-    bool result = _writeRegister(TFLUNA_I2C_SOFT_RESET, 0x02, addr);
-    delay(100); // Give time for the device to reset
-    return result;
+    return startSoftResetI2C(addr) && waitReady();
 }
 
 bool TFLuna::setHardResetI2C(uint8_t addr) {
-    bool result = _writeRegister(TFLUNA_I2C_SOFT_RESET, 0x01, addr);
-    delay(200); // Hard reset takes longer
-    return result;
+    return startHardResetI2C(addr) && waitReady();
 }
 
 bool TFLuna::setTriggerModeI2C(uint8_t addr) {
@@ -201,117 +820,120 @@ bool TFLuna::setDisableI2C(uint8_t addr) {
 
 // Information methods (I2C)
 bool TFLuna::getFirmwareVersion(uint8_t version[3], uint8_t addr) {
-    uint8_t value;
-    
-    if (!_readRegister(TFLUNA_I2C_FIRMWARE_L, value, addr)) {
-        return false;
+    if (isRegisterCacheValid(addr)) {
+        memcpy(version, &_regCache[TFLUNA_I2C_FIRMWARE_L - TFLUNA_I2C_CACHE_START], 3);
+        return true;
     }
-    version[0] = value;
     
-    if (!_readRegister(TFLUNA_I2C_FIRMWARE_M, value, addr)) {
-        return false;
-    }
-    version[1] = value;
-    
-    if (!_readRegister(TFLUNA_I2C_FIRMWARE_H, value, addr)) {
-        return false;
-    }
-    version[2] = value;
-    
-    return true;
+    return _readRegisters(TFLUNA_I2C_FIRMWARE_L, version, 3, addr);
 }
 
 bool TFLuna::getFrameRate(uint16_t &frameRate, uint8_t addr) {
+    if (isRegisterCacheValid(addr)) {
+        uint8_t idx = TFLUNA_I2C_FRAME_RATE - TFLUNA_I2C_CACHE_START;
+        frameRate = (_regCache[idx + 1] << 8) | _regCache[idx];
+        return true;
+    }
+    
     return _readRegister16(TFLUNA_I2C_FRAME_RATE, frameRate, addr);
 }
 
 bool TFLuna::getProductCode(char code[14], uint8_t addr) {
     // Product code is stored in registers 0x10-0x1D
-    Wire.beginTransmission(addr);
-    Wire.write(0x10);
-    if (Wire.endTransmission() != 0) {
-        _errorCode = TFLUNA_ERROR_I2C_NACK;
-        return false;
+    if (isRegisterCacheValid(addr)) {
+        memcpy(code, &_regCache[TFLUNA_I2C_PRODUCT_CODE - TFLUNA_I2C_CACHE_START], 14);
+        return true;
     }
     
-    Wire.requestFrom(addr, (uint8_t)14);
-    if (Wire.available() < 14) {
-        _errorCode = TFLUNA_ERROR_I2C_DATA;
-        return false;
+    return _readRegisters(TFLUNA_I2C_PRODUCT_CODE, (uint8_t*)code, 14, addr);
+}
+
+bool TFLuna::getTime(uint16_t &time, uint8_t addr) {
+    // Time is stored in registers 0x30-0x31
+    if (isRegisterCacheValid(addr)) {
+        uint8_t idx = TFLUNA_I2C_TIME - TFLUNA_I2C_CACHE_START;
+        time = (_regCache[idx + 1] << 8) | _regCache[idx];
+        return true;
     }
     
-    for (uint8_t i = 0; i < 14; i++) {
-        code[i] = Wire.read();
+    return _readRegister16(TFLUNA_I2C_TIME, time, addr);
+}
+
+// Register cache (I2C)
+bool TFLuna::refreshRegisterCache(uint8_t addr) {
+    _cacheValid = false;
+    
+    // Whole configuration block in as few bursts as the Wire buffer allows
+    uint8_t offset = 0;
+    while (offset < TFLUNA_I2C_CACHE_LENGTH) {
+        uint8_t length = TFLUNA_I2C_CACHE_LENGTH - offset;
+        if (length > TFLUNA_I2C_BURST_MAX) {
+            length = TFLUNA_I2C_BURST_MAX;
+        }
+        
+        if (!_readRegisters(TFLUNA_I2C_CACHE_START + offset, &_regCache[offset], length, addr)) {
+            return false;
+        }
+        offset += length;
     }
     
+    _cacheAddr = addr;
+    _cacheValid = true;
     return true;
 }
 
-bool TFLuna::getTime(uint16_t &time, uint8_t addr) {
-    // Time is stored in registers 0x30-0x31
-    return _readRegister16(0x30, time, addr);
+void TFLuna::invalidateRegisterCache() {
+    _cacheValid = false;
+}
+
+bool TFLuna::isRegisterCacheValid(uint8_t addr) const {
+    return _cacheValid && _cacheAddr == addr;
 }
 
 // Private helper methods
 bool TFLuna::_readFrame() {
-    uint8_t buffer[TFLUNA_FRAME_LENGTH];
-    uint8_t checksum = 0;
-    
-    // Wait for header bytes
+    // Blocking wrapper around the incremental parser
     uint32_t startTime = millis();
-    int headerCount = 0;
+    _errorCode = TFLUNA_OK;
+#if TFLUNA_LATENCY_HISTOGRAM
+    uint32_t startMicros = micros();
+#endif
     
-    while (headerCount < 2) {
-        if (millis() - startTime > 500) { // 500ms timeout
-            _errorCode = TFLUNA_ERROR_TIMEOUT;
-            return false;
+    while (true) {
+        if (poll()) {
+#if TFLUNA_LATENCY_HISTOGRAM
+            // A header received before the call counts from the call
+            uint32_t header = (int32_t)(_headerMicros - startMicros) > 0 ? _headerMicros : startMicros;
+            _latency[TFLUNA_LATENCY_HEADER].record(header - startMicros);
+            _latency[TFLUNA_LATENCY_PAYLOAD].record(_sampleMicros - header);
+#endif
+            return true;
         }
         
-        if (_stream->available()) {
-            uint8_t byte = _stream->read();
-            if (byte == TFLUNA_FRAME_HEADER) {
-                buffer[headerCount] = byte;
-                headerCount++;
-            } else {
-                headerCount = 0; // Reset if we don't get consecutive header bytes
-            }
-        }
-    }
-    
-    // Read the rest of the frame
-    uint8_t bytesRead = 2;
-    startTime = millis();
-    
-    while (bytesRead < TFLUNA_FRAME_LENGTH) {
-        if (millis() - startTime > 500) { // 500ms timeout
-            _errorCode = TFLUNA_ERROR_TIMEOUT;
+        // A complete frame arrived but failed validation
+        if (_errorCode != TFLUNA_OK) {
             return false;
         }
         
-        if (_stream->available()) {
-            buffer[bytesRead] = _stream->read();
-            bytesRead++;
+        if (millis() - startTime > TFLUNA_UART_TIMEOUT_MS) {
+            _stats.timeouts++;
+            _errorCode = TFLUNA_ERROR_TIMEOUT;
+            return false;
         }
     }
-    
-    // Calculate checksum
-    for (uint8_t i = 0; i < TFLUNA_FRAME_LENGTH - 1; i++) {
-        checksum += buffer[i];
-    }
-    
-    // Verify checksum
-    if (checksum != buffer[TFLUNA_FRAME_LENGTH - 1]) {
-        _errorCode = TFLUNA_ERROR_CHECKSUM;
-        return false;
-    }
-    
-    // Parse data
-    _distance = (buffer[3] << 8) | buffer[2];
-    _strength = (buffer[5] << 8) | buffer[4];
-    _temperature = (buffer[7] << 8) | buffer[6];
-    
-    _errorCode = TFLUNA_OK;
-    return true;
+}
+
+void TFLuna::_resetParser() {
+    _parseState = TFLUNA_PARSE_HEADER1;
+    _frameIndex = 0;
+}
+
+void TFLuna::_decodeFrame(const uint8_t* frame, Sample &sample) {
+    sample.distance = (frame[3] << 8) | frame[2];
+    sample.strength = (frame[5] << 8) | frame[4];
+    sample.temperature = (int16_t)((frame[7] << 8) | frame[6]);
+    sample.timestamp = 0;
+    sample.unit = _unit;    // Fixed by the output format, so no per-frame branch
 }
 
 uint8_t TFLuna::_calculateChecksum(uint8_t *data, uint8_t length) {
@@ -323,174 +945,324 @@ uint8_t TFLuna::_calculateChecksum(uint8_t *data, uint8_t length) {
 }
 
 bool TFLuna::_sendCommand(uint8_t cmd, uint8_t *payload, uint8_t payloadLen) {
-    if (_mode != TFLUNA_UART_MODE || _stream == NULL) {
-        _errorCode = TFLUNA_ERROR_SERIAL;
+    // Blocking wrapper around the command queue
+    uint8_t ticket = queueCommand(cmd, payload, payloadLen);
+    if (ticket == 0) {
         return false;
     }
     
-    // Command format: [0x5A][Length][Cmd][Payload][Checksum]
-    uint8_t length = payloadLen + 2; // Cmd + Payload
-    uint8_t buffer[32]; // Max command length
-    uint8_t idx = 0;
+    // Data frames arriving meanwhile are parsed as usual
+    uint8_t status = getCommandStatus(ticket);
+    while (status == TFLUNA_CMD_QUEUED || status == TFLUNA_CMD_SENT) {
+        poll();
+        status = getCommandStatus(ticket);
+    }
     
-    buffer[idx++] = 0x5A; // Header
-    buffer[idx++] = length; // Length
-    buffer[idx++] = cmd; // Command
+    _errorCode = getCommandError(ticket);
+    return status == TFLUNA_CMD_DONE;
+}
+
+void TFLuna::_handleReply(const uint8_t* reply, uint8_t length) {
+    // The parser has checked the length already, but the reply is indexed by
+    // it, so do not trust the caller
+    if (length < TFLUNA_CMD_MIN_LENGTH || length > TFLUNA_CMD_MAX_LENGTH) {
+        return;
+    }
     
-    // Add payload if any
-    for (uint8_t i = 0; i < payloadLen; i++) {
-        buffer[idx++] = payload[i];
+    // Only the command in flight can be answered; anything else is stale
+    if (_commandCount == 0) {
+        return;
+    }
+    Command &command = _commands[_commandHead];
+    if (command.status != TFLUNA_CMD_SENT || reply[2] != command.id) {
+        return;
     }
     
-    // Calculate checksum
-    buffer[idx] = _calculateChecksum(buffer, idx);
-    idx++;
+    const uint8_t* data = &reply[3];
+    uint8_t dataLen = length - TFLUNA_CMD_MIN_LENGTH;
+    uint8_t errorCode = TFLUNA_OK;
     
-    // Send command
-    _stream->write(buffer, idx);
+    switch (command.id) {
+        case TFLUNA_CMD_SOFT_RESET:
+        case TFLUNA_CMD_FACTORY_RESET:
+        case TFLUNA_CMD_SAVE_SETTINGS:
+            // Status byte, zero on success
+            if (dataLen < 1 || data[0] != 0) {
+                errorCode = TFLUNA_ERROR_COMMAND;
+            }
+            break;
+        
+        case TFLUNA_CMD_GET_VERSION:
+            break;
+        
+        default:
+            // Settings are echoed back
+            if (dataLen != command.payloadLen || memcmp(data, command.payload, dataLen) != 0) {
+                errorCode = TFLUNA_ERROR_COMMAND;
+            }
+            break;
+    }
     
-    // Wait for response
-    uint32_t startTime = millis();
-    while (_stream->available() < 5) { // Minimum response length
-        if (millis() - startTime > 500) { // 500ms timeout
-            _errorCode = TFLUNA_ERROR_TIMEOUT;
-            return false;
+    _finishCommand(errorCode);
+}
+
+void TFLuna::_finishCommand(uint8_t errorCode) {
+    Command &command = _commands[_commandHead];
+    command.status = (errorCode == TFLUNA_OK) ? TFLUNA_CMD_DONE : TFLUNA_CMD_FAILED;
+    command.errorCode = errorCode;
+    if (errorCode != TFLUNA_OK) {
+        _stats.commandFailures++;
+        if (errorCode == TFLUNA_ERROR_TIMEOUT) {
+            _stats.timeouts++;
         }
     }
     
-    // Read response header
-    if (_stream->read() != 0x5A) {
-        _errorCode = TFLUNA_ERROR_HEADER;
+    _commandHead = (_commandHead + 1) % TFLUNA_CMD_QUEUE_LENGTH;
+    _commandCount--;
+    
+    // Last, so the callback can queue the next command
+    if (command.callback != nullptr) {
+        command.callback(command.ticket, command.id, errorCode);
+    }
+}
+
+const TFLuna::Command* TFLuna::_findCommand(uint8_t ticket) const {
+    if (ticket == 0) {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < TFLUNA_CMD_QUEUE_LENGTH; i++) {
+        if (_commands[i].ticket == ticket) {
+            return &_commands[i];
+        }
+    }
+    return NULL;
+}
+
+bool TFLuna::_canSetPortBaud() const {
+    return _serial != NULL;
+}
+
+bool TFLuna::_setPortBaud(uint32_t baudRate) {
+    if (!_canSetPortBaud()) {
         return false;
     }
     
-    // Read response length
-    uint8_t respLength = _stream->read();
-    
-    // Read response command
-    uint8_t respCmd = _stream->read();
-    if (respCmd != cmd) {
-        _errorCode = TFLUNA_ERROR_HEADER;
+    _serial->end();
+    _serial->begin(baudRate);
+    return true;
+}
+
+bool TFLuna::_openPort(uint32_t baudRate) {
+    // Let the last command leave at the old rate
+    _stream->flush();
+    if (!_setPortBaud(baudRate)) {
+        _errorCode = TFLUNA_ERROR_SERIAL;
         return false;
     }
+    _baudRate = baudRate;
     
-    // Read response status
-    uint8_t status = _stream->read();
-    
-    // Read checksum
-    uint8_t respChecksum = _stream->read();
-    
-    // Calculate expected checksum
-    uint8_t expectedChecksum = 0x5A + respLength + respCmd + status;
-    
-    // Verify checksum
-    if (respChecksum != expectedChecksum) {
-        _errorCode = TFLUNA_ERROR_CHECKSUM;
-        return false;
+    // Bytes received around the switch are noise
+    while (_stream->available()) {
+        _stream->read();
     }
+    _resetParser();
+    return true;
+}
+
+bool TFLuna::_verifyBaud(uint16_t timeoutMs) {
+    // Two valid frames: noise at a wrong rate can pass one checksum, rarely two
+    for (uint8_t i = 0; i < 2; i++) {
+        _startReady(0, 0, timeoutMs, true);
+        if (!waitReady()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TFLuna::_startReady(uint8_t addr, uint8_t ticket, uint16_t timeoutMs, bool probeNow) {
+    _readyState = TFLUNA_READY_WAITING;
+    _readyAddr = addr;
+    _readyTicket = ticket;
+    _readyTimeout = timeoutMs;
+    _readyInterval = TFLUNA_READY_POLL_MS;
+    _readyStart = millis();
     
-    // Check status
-    if (status != 0) {
-        _errorCode = status;
-        return false;
+    // After a reset the device may still answer for a moment, so the first
+    // probe waits one interval
+    _readyProbe = probeNow ? _readyStart - TFLUNA_READY_POLL_MS : _readyStart;
+}
+
+bool TFLuna::_restoreSettings(bool factory) {
+    // A factory reset also overwrites the saved settings
+    if (factory) {
+        _savedUnit = TFLUNA_UNIT_CM;
+        _savedRate = TFLUNA_DEFAULT_FRAME_RATE;
+        _savedBaud = TFLUNA_DEFAULT_BAUD;
     }
+    _unit = _savedUnit;
+    _continuousRate = _savedRate;
     
-    _errorCode = TFLUNA_OK;
-    return true;
+    // Frames after the reset come at the restored rate
+    if (_baudRate == _savedBaud) {
+        return true;
+    }
+    return _openPort(_savedBaud);
+}
+
+bool TFLuna::_startResetI2C(uint8_t value, uint8_t addr, uint8_t readyAddr) {
+    bool result = _writeRegister(TFLUNA_I2C_SOFT_RESET, value, addr);
+    if (isRegisterCacheValid(addr)) {
+        invalidateRegisterCache(); // Unsaved settings revert on reset
+    }
+    if (result) {
+        _startReady(readyAddr, 0, TFLUNA_RESET_TIMEOUT_MS, false);
+    }
+    return result;
 }
 
 bool TFLuna::_writeRegister(uint8_t reg, uint8_t value, uint8_t addr) {
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
-    Wire.write(value);
-    if (Wire.endTransmission() != 0) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_BUS);
+    _busTransactions++;
+    _wire->beginTransmission(addr);
+    _wire->write(reg);
+    _wire->write(value);
+    if (_wire->endTransmission() != 0) {
+        _stats.nacks++;
         _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
     }
     
+    _updateRegisterCache(reg, value, addr);
     _errorCode = TFLUNA_OK;
     return true;
 }
 
 bool TFLuna::_writeRegister16(uint8_t reg, uint16_t value, uint8_t addr) {
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
-    Wire.write(value & 0xFF);         // Low byte
-    Wire.write((value >> 8) & 0xFF);  // High byte
-    if (Wire.endTransmission() != 0) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_BUS);
+    _busTransactions++;
+    _wire->beginTransmission(addr);
+    _wire->write(reg);
+    _wire->write(value & 0xFF);         // Low byte
+    _wire->write((value >> 8) & 0xFF);  // High byte
+    if (_wire->endTransmission() != 0) {
+        _stats.nacks++;
         _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
     }
     
+    _updateRegisterCache(reg, value & 0xFF, addr);
+    _updateRegisterCache(reg + 1, (value >> 8) & 0xFF, addr);
     _errorCode = TFLUNA_OK;
     return true;
 }
 
 bool TFLuna::_readRegister(uint8_t reg, uint8_t &value, uint8_t addr) {
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
-    if (Wire.endTransmission() != 0) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_BUS);
+    _busTransactions++;
+    _wire->beginTransmission(addr);
+    _wire->write(reg);
+    if (_wire->endTransmission() != 0) {
+        _stats.nacks++;
         _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
     }
     
-    Wire.requestFrom(addr, (uint8_t)1);
-    if (Wire.available() < 1) {
+    _wire->requestFrom(addr, (uint8_t)1);
+    if (_wire->available() < 1) {
+        _stats.shortReads++;
         _errorCode = TFLUNA_ERROR_I2C_DATA;
         return false;
     }
     
-    value = Wire.read();
+    value = _wire->read();
     
     _errorCode = TFLUNA_OK;
     return true;
 }
 
 bool TFLuna::_readRegister16(uint8_t reg, uint16_t &value, uint8_t addr) {
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
-    if (Wire.endTransmission() != 0) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_BUS);
+    _busTransactions++;
+    _wire->beginTransmission(addr);
+    _wire->write(reg);
+    if (_wire->endTransmission() != 0) {
+        _stats.nacks++;
         _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
     }
     
-    Wire.requestFrom(addr, (uint8_t)2);
-    if (Wire.available() < 2) {
+    _wire->requestFrom(addr, (uint8_t)2);
+    if (_wire->available() < 2) {
+        _stats.shortReads++;
         _errorCode = TFLUNA_ERROR_I2C_DATA;
         return false;
     }
     
-    uint8_t low = Wire.read();
-    uint8_t high = Wire.read();
+    uint8_t low = _wire->read();
+    uint8_t high = _wire->read();
     value = (high << 8) | low;
     
     _errorCode = TFLUNA_OK;
     return true;
 }
 
-bool TFLuna::_readData(uint8_t addr) {
-    uint16_t dist, strength;
-    int16_t temp;
-    
-    // Read distance
-    if (!_readRegister16(TFLUNA_I2C_DIST_L, dist, addr)) {
+bool TFLuna::_readRegisters(uint8_t reg, uint8_t *buffer, uint8_t length, uint8_t addr) {
+    TFLUNA_TIME_BLOCK(TFLUNA_LATENCY_BUS);
+    _busTransactions++;
+    _wire->beginTransmission(addr);
+    _wire->write(reg);
+    if (_wire->endTransmission(false) != 0) { // Repeated start keeps the block coherent
+        _stats.nacks++;
+        _errorCode = TFLUNA_ERROR_I2C_NACK;
         return false;
     }
     
-    // Read signal strength
-    if (!_readRegister16(TFLUNA_I2C_STRENGTH_L, strength, addr)) {
+    _wire->requestFrom(addr, length);
+    if (_wire->available() < length) {
+        _stats.shortReads++;
+        _errorCode = TFLUNA_ERROR_I2C_DATA;
         return false;
     }
     
-    // Read temperature
-    if (!_readRegister16(TFLUNA_I2C_TEMP_L, temp, addr)) {
+    for (uint8_t i = 0; i < length; i++) {
+        buffer[i] = _wire->read();
+    }
+    
+    _errorCode = TFLUNA_OK;
+    return true;
+}
+
+bool TFLuna::_readData(uint8_t addr) {
+    uint8_t buffer[TFLUNA_I2C_DATA_LENGTH];
+    
+    // Distance, strength, temperature and tick in a single burst so all
+    // fields come from the same measurement
+    if (!_readRegisters(TFLUNA_I2C_DIST_L, buffer, TFLUNA_I2C_DATA_LENGTH, addr)) {
         return false;
     }
     
-    _distance = dist;
-    _strength = strength;
-    _temperature = temp;
+    _distance = (buffer[1] << 8) | buffer[0];
+    _strength = (buffer[3] << 8) | buffer[2];
+    _temperature = (int16_t)((buffer[5] << 8) | buffer[4]);
+    _timestamp = (buffer[7] << 8) | buffer[6];
+    _sampleMicros = micros();
+    _sequence++;
+    _stats.framesOk++;
     
     _errorCode = TFLUNA_OK;
     return true;
 }
+
+void TFLuna::_updateRegisterCache(uint8_t reg, uint8_t value, uint8_t addr) {
+    // Keep the mirror in step with successful writes to settings registers;
+    // command registers (save, reset) do not hold a value
+    if (!isRegisterCacheValid(addr) ||
+        reg == TFLUNA_I2C_SAVE_SETTINGS || reg == TFLUNA_I2C_SOFT_RESET) {
+        return;
+    }
+    
+    if (reg >= TFLUNA_I2C_CACHE_START && reg < TFLUNA_I2C_CACHE_START + TFLUNA_I2C_CACHE_LENGTH) {
+        _regCache[reg - TFLUNA_I2C_CACHE_START] = value;
+    }
+}
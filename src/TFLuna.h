@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "TFLunaLatency.h"
 
 // Communication modes
 #define TFLUNA_UART_MODE 0
@@ -20,10 +21,85 @@
 #define TFLUNA_ERROR_I2C_NACK      5
 #define TFLUNA_ERROR_I2C_DATA      6
 #define TFLUNA_ERROR_INVALID_PARAM 7
+#define TFLUNA_ERROR_COMMAND       8   // Sensor rejected or did not echo a command
+#define TFLUNA_ERROR_BUSY          9   // Command queue full
 
 // UART frame format
 #define TFLUNA_FRAME_HEADER        0x59
 #define TFLUNA_FRAME_LENGTH        9
+#define TFLUNA_UART_TIMEOUT_MS     500
+
+// UART output formats (command 0x05). Both use the 9-byte frame; only the
+// unit of the distance field differs.
+#define TFLUNA_FORMAT_CM           0x01  // Default
+#define TFLUNA_FORMAT_MM           0x06
+
+// Unit of Sample::distance
+#define TFLUNA_UNIT_CM             0
+#define TFLUNA_UNIT_MM             1
+
+// UART baud rates
+#define TFLUNA_DEFAULT_BAUD        115200
+#define TFLUNA_BAUD_COUNT          14    // Rates the sensor supports, 9600 to 921600
+#define TFLUNA_BAUD_VERIFY_MS      500   // For frames at the new rate after a switch
+#define TFLUNA_BAUD_DETECT_MS      100   // Per candidate rate
+
+// Frame rate after a factory reset
+#define TFLUNA_DEFAULT_FRAME_RATE  100
+
+// UART parser states
+#define TFLUNA_PARSE_HEADER1       0
+#define TFLUNA_PARSE_HEADER2       1
+#define TFLUNA_PARSE_PAYLOAD       2
+#define TFLUNA_PARSE_REPLY_LENGTH  3
+#define TFLUNA_PARSE_REPLY         4
+
+// UART command frames: [0x5A][Length][ID][Payload][Checksum], where Length
+// counts the whole frame and the checksum is the low byte of the sum
+#define TFLUNA_CMD_HEADER          0x5A
+#define TFLUNA_CMD_MIN_LENGTH      4
+#define TFLUNA_CMD_MAX_LENGTH      TFLUNA_FRAME_LENGTH
+#define TFLUNA_CMD_MAX_PAYLOAD     (TFLUNA_CMD_MAX_LENGTH - TFLUNA_CMD_MIN_LENGTH)
+#define TFLUNA_CMD_TIMEOUT_MS      TFLUNA_UART_TIMEOUT_MS
+#define TFLUNA_CMD_QUEUE_LENGTH    4
+
+// UART command IDs
+#define TFLUNA_CMD_GET_VERSION     0x01
+#define TFLUNA_CMD_SOFT_RESET      0x02
+#define TFLUNA_CMD_FRAME_RATE      0x03
+#define TFLUNA_CMD_TRIGGER         0x04
+#define TFLUNA_CMD_OUTPUT_FORMAT   0x05
+#define TFLUNA_CMD_BAUD_RATE       0x06
+#define TFLUNA_CMD_OUTPUT_ENABLE   0x07
+#define TFLUNA_CMD_FACTORY_RESET   0x10
+#define TFLUNA_CMD_SAVE_SETTINGS   0x11
+
+// Status of a queued command
+#define TFLUNA_CMD_UNKNOWN         0   // No such ticket, or its slot was reused
+#define TFLUNA_CMD_QUEUED          1
+#define TFLUNA_CMD_SENT            2
+#define TFLUNA_CMD_DONE            3
+#define TFLUNA_CMD_FAILED          4
+
+// Device readiness after power-up, reset or save
+#define TFLUNA_READY_IDLE          0   // No wait started
+#define TFLUNA_READY_WAITING       1
+#define TFLUNA_READY_OK            2
+#define TFLUNA_READY_FAILED        3   // Deadline passed or the command failed
+
+// Readiness deadlines; the waits end as soon as the device answers
+#define TFLUNA_READY_POLL_MS       5     // Between probes, and before the first after a reset
+#define TFLUNA_READY_TRIGGER_MAX_MS 80    // UART triggers back off up to this
+#define TFLUNA_BOOT_TIMEOUT_MS     500
+#define TFLUNA_RESET_TIMEOUT_MS    500
+#define TFLUNA_SAVE_TIMEOUT_MS     1000
+
+// Latency histograms kept with TFLUNA_LATENCY_HISTOGRAM
+#define TFLUNA_LATENCY_CALL        0   // Whole getData() / getDataI2C() call
+#define TFLUNA_LATENCY_HEADER      1   // getData() until the frame header arrived
+#define TFLUNA_LATENCY_PAYLOAD     2   // Header until the frame was complete
+#define TFLUNA_LATENCY_BUS         3   // One I2C register transaction
+#define TFLUNA_LATENCY_PHASES      4
 
 // I2C registers
 #define TFLUNA_I2C_DIST_L          0x00
@@ -32,41 +108,149 @@
 #define TFLUNA_I2C_STRENGTH_H      0x03
 #define TFLUNA_I2C_TEMP_L          0x04
 #define TFLUNA_I2C_TEMP_H          0x05
+#define TFLUNA_I2C_TICK_L          0x06
+#define TFLUNA_I2C_TICK_H          0x07
 #define TFLUNA_I2C_FIRMWARE_L      0x0A
 #define TFLUNA_I2C_FIRMWARE_M      0x0B
 #define TFLUNA_I2C_FIRMWARE_H      0x0C
+#define TFLUNA_I2C_PRODUCT_CODE    0x10
 #define TFLUNA_I2C_SAVE_SETTINGS   0x20
 #define TFLUNA_I2C_SOFT_RESET      0x21
 #define TFLUNA_I2C_SET_I2C_ADDR    0x22
 #define TFLUNA_I2C_FRAME_RATE      0x25
+#define TFLUNA_I2C_TIME            0x30
 #define TFLUNA_I2C_TRIG_MODE       0x40
 #define TFLUNA_I2C_CONT_MODE       0x41
 #define TFLUNA_I2C_TRIG_SAMPLE     0x42
 #define TFLUNA_I2C_ENABLE          0x60
 #define TFLUNA_I2C_DISABLE         0x65
 
+// Measurement block read in one burst: distance, strength, temperature, tick
+#define TFLUNA_I2C_DATA_LENGTH     8
+
+// Configuration block mirrored by the register cache (0x0A-0x31)
+#define TFLUNA_I2C_CACHE_START     TFLUNA_I2C_FIRMWARE_L
+#define TFLUNA_I2C_CACHE_LENGTH    (TFLUNA_I2C_TIME + 2 - TFLUNA_I2C_CACHE_START)
+
+// Largest single read supported by the Wire buffer on all cores
+#define TFLUNA_I2C_BURST_MAX       32
+
 class TFLuna {
 public:
+    // One decoded measurement
+    struct __attribute__((packed)) Sample {
+        uint16_t distance;      // Distance in cm, or mm when unit is TFLUNA_UNIT_MM
+        uint16_t strength;      // Signal strength
+        int16_t temperature;    // Temperature in 0.01°C
+        uint16_t timestamp;     // Device tick (I2C register 0x06), 0 for UART frames
+        uint32_t hostMicros;    // micros() when the frame completed
+        uint32_t sequence;      // Frames seen by this instance, gaps mean lost frames
+        uint8_t unit;           // TFLUNA_UNIT_CM or TFLUNA_UNIT_MM
+    };
+
+    // Acquisition statistics, counted since construction or the last reset
+    struct Statistics {
+        uint32_t framesOk;          // Frames and I2C readings that decoded
+        uint32_t checksumErrors;    // Data frames and command replies
+        uint32_t headerErrors;      // Header starts that turned out not to be one
+        uint32_t bytesDiscarded;    // Bytes skipped while looking for a header
+        uint32_t timeouts;          // Frame, command reply and readiness waits
+        uint32_t nacks;             // I2C transactions not acknowledged
+        uint32_t shortReads;        // I2C reads returning fewer bytes than requested
+        uint32_t commandFailures;   // Commands rejected, not echoed or timed out
+    };
+
     // Constructors
-    TFLuna();                      // For I2C mode
+    TFLuna();                      // For I2C mode on Wire
+    TFLuna(TwoWire* wire);         // For I2C mode on another controller, e.g. &Wire1
     TFLuna(HardwareSerial* serial); // For UART mode with HardwareSerial
     TFLuna(Stream* stream);        // For UART mode with any Stream
 
     // Initialization
-    bool begin(uint32_t baudRate = 115200);  // Initialize UART mode
-    bool beginI2C();                         // Initialize I2C mode
+    // Both wait until the sensor answers, at most TFLUNA_BOOT_TIMEOUT_MS.
+    // beginI2C() then returns false with TFLUNA_ERROR_TIMEOUT; begin() only
+    // sets the error code, as a sensor with its output disabled sends nothing
+    bool begin(uint32_t baudRate = TFLUNA_DEFAULT_BAUD); // Initialize UART mode
+    bool beginI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR); // Initialize I2C mode
+
+    virtual ~TFLuna() {}
 
     // Data acquisition
-    bool getData();                          // Get data in UART mode
-    bool getDataI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR); // Get data in I2C mode
+    virtual bool getData();                  // Get data in UART mode (blocking)
+    virtual bool getDataI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR); // Get data in I2C mode
+
+    // Non-blocking UART acquisition
+    bool poll();                             // Consume buffered bytes, true when a frame completes
+    bool feed(uint8_t byte);                 // Feed one received byte, true when a frame completes
+    size_t decodeFrames(const uint8_t* data, size_t length,
+                        Sample* samples, size_t maxSamples,
+                        size_t &consumed, size_t &dropped); // Decode every frame in a byte buffer
+
+    // Timestamped acquisition, UART or I2C depending on the mode
+    bool read(Sample &sample, uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    void getSample(Sample &sample) const;    // Last sample, no bus traffic
 
     // Data accessors
-    uint16_t getDistance() const;      // Get distance in cm
+    uint16_t getDistance() const;      // Get distance in cm, or mm in millimetre format
+    uint8_t getDistanceUnit() const;   // TFLUNA_UNIT_CM or TFLUNA_UNIT_MM
     uint16_t getSignalStrength() const; // Get signal strength
     int16_t getTemperature() const;    // Get temperature in 0.01°C
     uint8_t getErrorCode() const;      // Get last error code
+    uint8_t getMode() const;           // TFLUNA_UART_MODE or TFLUNA_I2C_MODE
+    uint16_t getTimestamp() const;     // Get device tick of the last I2C reading
+
+    // Bus statistics (I2C)
+    TwoWire* getWire() const;            // Controller used by this instance
+    uint32_t getBusTransactions() const; // Register transactions issued since reset
+    void resetBusTransactions();
+
+    // Acquisition statistics
+    void getStatistics(Statistics &stats) const;  // Snapshot of the counters
+    void resetStatistics();
+
+#if TFLUNA_LATENCY_HISTOGRAM
+    // Latency histograms per TFLUNA_LATENCY_* phase. Calls are timed whether
+    // they succeed or not; the header and payload phases only for frames
+    // that decode.
+    const TFLunaLatencyHistogram& getLatencyHistogram(uint8_t phase) const;
+    uint32_t getLatencyPercentile(uint8_t phase, uint8_t percent) const; // us
+    void resetLatency();
+#endif
+
+    // Asynchronous commands (UART). Commands are sent one at a time from
+    // poll() and completed when their reply is picked out of the data stream,
+    // so measurements keep flowing while the sensor is reconfigured.
+    typedef void (*CommandCallback)(uint8_t ticket, uint8_t command, uint8_t errorCode);
+    uint8_t queueCommand(uint8_t command, const uint8_t* payload = NULL, uint8_t payloadLen = 0,
+                         CommandCallback callback = nullptr); // Returns a ticket, 0 when the queue is full
+    uint8_t getCommandStatus(uint8_t ticket) const;  // TFLUNA_CMD_QUEUED ... TFLUNA_CMD_FAILED
+    uint8_t getCommandError(uint8_t ticket) const;   // Error code of a failed command
+    bool isCommandPending() const;
+    void serviceCommands();                          // Send and time out commands, done by poll()
+
+    // Readiness. The start* variants send the command and return at once;
+    // pollReady() then probes the device (a register read over I2C, the first
+    // frame over UART) without blocking, so several sensors can restart in
+    // parallel. The blocking reset and save methods are start + waitReady().
+    bool startSoftReset();
+    bool startHardReset();
+    bool startSoftResetI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    bool startHardResetI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    bool startSaveSettingsI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    uint8_t pollReady();                     // TFLUNA_READY_*
+    bool waitReady();                        // Block until ready or the deadline
+    bool pingI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR); // True when the device answers a register read
 
-    // Configuration methods (UART)
+    // Baud rate (UART). setBaudRate() changes the sensor rate, reopens the
+    // port and verifies frames at the new rate, going back to the old rate
+    // when they do not come. detectBaudRate() tries every supported rate
+    // until frames decode. Both need a HardwareSerial port.
+    bool setBaudRate(uint32_t baudRate);
+    uint32_t detectBaudRate();               // Rate found, 0 when none worked
+    uint32_t getBaudRate() const;            // Rate the port is open at
+    static bool isSupportedBaudRate(uint32_t baudRate);
+
+    // Configuration methods (UART), blocking until the reply arrives
     bool setFrameRate(uint16_t frameRate);
     bool setSaveSettings();
     bool setSoftReset();
@@ -76,6 +260,8 @@ public:
     bool triggerSample();
     bool setEnable();
     bool setDisable();
+    bool setOutputFormat(uint8_t format);    // TFLUNA_FORMAT_CM or TFLUNA_FORMAT_MM
+    uint8_t getOutputFormat() const;
 
     // Configuration methods (I2C)
     bool setFrameRateI2C(uint16_t frameRate, uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
@@ -95,31 +281,121 @@ public:
     bool getProductCode(char code[14], uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
     bool getTime(uint16_t &time, uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
 
+    // Register cache (I2C). Once filled, the information methods above are
+    // served from RAM for that address until a reset or address change.
+    bool refreshRegisterCache(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    void invalidateRegisterCache();
+    bool isRegisterCacheValid(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR) const;
+
+protected:
+    // Data storage
+    uint16_t _distance;
+    uint16_t _strength;
+    int16_t _temperature;
+    uint16_t _timestamp = 0;
+    uint32_t _sampleMicros = 0;
+    uint32_t _sequence = 0;
+    uint8_t _unit = TFLUNA_UNIT_CM;   // Of _distance, follows the output format
+    uint8_t _errorCode;
+
+    // Reopen the UART at another rate; overridden to simulate the link
+    virtual bool _canSetPortBaud() const;
+    virtual bool _setPortBaud(uint32_t baudRate);
+
 private:
     // Communication mode
     uint8_t _mode;
 
+    // I2C related
+    TwoWire* _wire;
+
     // UART related
     Stream* _stream;
+    HardwareSerial* _serial;          // Same port when the rate can be set, else NULL
+    uint32_t _baudRate = TFLUNA_DEFAULT_BAUD;
     bool _ownSerial;
 
-    // Data storage
-    uint16_t _distance;
-    uint16_t _strength;
-    int16_t _temperature;
-    uint8_t _errorCode;
+    // I2C bus cycle counter
+    uint32_t _busTransactions = 0;
+
+    // Error counters, incremented only on the paths they count
+    Statistics _stats = {};
+
+#if TFLUNA_LATENCY_HISTOGRAM
+    TFLunaLatencyHistogram _latency[TFLUNA_LATENCY_PHASES];
+    uint32_t _headerMicros = 0;       // micros() when the last header completed
+#endif
+
+    // Mirror of the configuration registers of one device
+    uint8_t _regCache[TFLUNA_I2C_CACHE_LENGTH];
+    uint8_t _cacheAddr = 0;
+    bool _cacheValid = false;
+
+    // UART parser state, kept between calls so frames can arrive in pieces
+    uint8_t _parseState = TFLUNA_PARSE_HEADER1;
+    uint8_t _frameIndex = 0;
+    uint8_t _frameLength = 0;         // Of the command reply being received
+    uint8_t _frameBuffer[TFLUNA_FRAME_LENGTH];
+
+    // UART command queue: a ring of slots, commands run in ticket order. A
+    // finished slot keeps its status until the ring wraps onto it.
+    struct Command {
+        uint8_t ticket;
+        uint8_t id;
+        uint8_t payload[TFLUNA_CMD_MAX_PAYLOAD];
+        uint8_t payloadLen;
+        uint8_t status;
+        uint8_t errorCode;
+        uint32_t sentMillis;
+        CommandCallback callback;
+    };
+    Command _commands[TFLUNA_CMD_QUEUE_LENGTH] = {};
+    uint8_t _commandHead = 0;      // Oldest unfinished command
+    uint8_t _commandCount = 0;     // Unfinished commands
+    uint8_t _nextTicket = 1;
+    uint16_t _continuousRate = TFLUNA_DEFAULT_FRAME_RATE; // Restored by setContinuousMode()
+
+    // Settings the sensor comes back with after a soft reset (last saved)
+    uint8_t _savedUnit = TFLUNA_UNIT_CM;
+    uint16_t _savedRate = TFLUNA_DEFAULT_FRAME_RATE;
+    uint32_t _savedBaud = TFLUNA_DEFAULT_BAUD;
+
+    // Readiness wait of one device
+    uint8_t _readyState = TFLUNA_READY_IDLE;
+    uint8_t _readyAddr = TFLUNA_DEFAULT_I2C_ADDR;
+    uint8_t _readyTicket = 0;      // UART command to finish before frames count
+    uint16_t _readyTimeout = 0;
+    uint16_t _readyInterval = TFLUNA_READY_POLL_MS; // Until the next UART trigger
+    uint32_t _readyStart = 0;      // millis()
+    uint32_t _readyProbe = 0;      // millis() of the last probe
 
     // UART helper methods
     bool _readFrame();
+    void _resetParser();
+    void _decodeFrame(const uint8_t* frame, Sample &sample);
     uint8_t _calculateChecksum(uint8_t *data, uint8_t length);
     bool _sendCommand(uint8_t cmd, uint8_t *payload = NULL, uint8_t payloadLen = 0);
+    void _handleReply(const uint8_t* reply, uint8_t length);
+    void _finishCommand(uint8_t errorCode);
+    const Command* _findCommand(uint8_t ticket) const;
+
+    // Readiness helper methods
+    void _startReady(uint8_t addr, uint8_t ticket, uint16_t timeoutMs, bool probeNow);
+    bool _restoreSettings(bool factory);
+    bool _startResetI2C(uint8_t value, uint8_t addr, uint8_t readyAddr);
+
+    // Baud rate helper methods
+    bool _openPort(uint32_t baudRate);
+    bool _verifyBaud(uint16_t timeoutMs);
 
     // I2C helper methods
     bool _writeRegister(uint8_t reg, uint8_t value, uint8_t addr);
     bool _writeRegister16(uint8_t reg, uint16_t value, uint8_t addr);
     bool _readRegister(uint8_t reg, uint8_t &value, uint8_t addr);
     bool _readRegister16(uint8_t reg, uint16_t &value, uint8_t addr);
+    bool _readRegisters(uint8_t reg, uint8_t *buffer, uint8_t length, uint8_t addr);
     bool _readData(uint8_t addr);
+    void _updateRegisterCache(uint8_t reg, uint8_t value, uint8_t addr);
 };
 
 #endif // TFLUNA_H
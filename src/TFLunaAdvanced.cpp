@@ -1,5 +1,40 @@
 #include "TFLunaAdvanced.h"
 
+// Fixed-point conversion kernels shared by the single and batch variants.
+// Each replaces a divide by a constant with a multiply and a shift. Distance
+// factors are indexed by Sample::unit, so mixed batches need no branch.
+static const uint8_t millimetersPerUnit[2] = { 10, 1 };
+static const uint16_t metersQ16Factor[2] = { 41943, 33554 };    // x 655.36, x 65.536
+static const uint8_t metersQ16Shift[2] = { 6, 9 };
+static const uint16_t inchesQ8Factor[2] = { 51603, 41283 };     // x 100.787, x 10.079
+static const uint8_t inchesQ8Shift[2] = { 9, 12 };
+
+static inline uint32_t distanceToMillimeters(uint16_t distance, uint8_t unit) {
+    return (uint32_t)distance * millimetersPerUnit[unit & 1];
+}
+
+static inline uint32_t distanceToMetersQ16(uint16_t distance, uint8_t unit) {
+    return ((uint32_t)distance * metersQ16Factor[unit & 1]) >> metersQ16Shift[unit & 1];
+}
+
+static inline uint32_t distanceToInchesQ8(uint16_t distance, uint8_t unit) {
+    return ((uint32_t)distance * inchesQ8Factor[unit & 1]) >> inchesQ8Shift[unit & 1];
+}
+
+static inline int32_t centiCelsiusToCentiFahrenheit(int16_t centiCelsius) {
+    return ((((int32_t)centiCelsius * 29491L) + 8192) >> 14) + 3200;   // x 1.8 + 32°F
+}
+
+static inline uint8_t strengthToQuality(uint16_t strength) {
+    // Linear mapping from 30-2000 to 0-100%, exact for every strength in range
+    if (strength < 30) {
+        return 0;
+    } else if (strength > 2000) {
+        return 100;
+    }
+    return (uint8_t)(((uint32_t)(strength - 30) * 26615UL) >> 19);
+}
+
 // Distance filtering methods
 void TFLunaAdvanced::enableMedianFilter(uint8_t windowSize) {
     // Ensure window size is odd for proper median calculation
@@ -10,114 +45,46 @@ void TFLunaAdvanced::enableMedianFilter(uint8_t windowSize) {
     // Limit window size to reasonable values
     if (windowSize < 3) {
         windowSize = 3;
-    } else if (windowSize > 15) {
-        windowSize = 15;
+    } else if (windowSize > TFLUNA_MEDIAN_MAX_WINDOW) {
+        windowSize = TFLUNA_MEDIAN_MAX_WINDOW;
     }
     
     _medianWindowSize = windowSize;
     _medianFilterEnabled = true;
-    
-    // Allocate or reallocate buffer if needed
-    uint8_t requiredSize = _medianFilterEnabled ? _medianWindowSize : 0;
-    requiredSize = _averageFilterEnabled ? max(requiredSize, _averageWindowSize) : requiredSize;
-    
-    if (requiredSize > _bufferSize) {
-        if (_distanceBuffer != nullptr) {
-            delete[] _distanceBuffer;
-        }
-        
-        _distanceBuffer = new uint16_t[requiredSize];
-        _bufferSize = requiredSize;
-        _bufferIndex = 0;
-        _bufferFilled = false;
-        
-        // Initialize buffer with zeros
-        for (uint8_t i = 0; i < _bufferSize; i++) {
-            _distanceBuffer[i] = 0;
-        }
-    }
+    _configureFilters();
 }
 
 void TFLunaAdvanced::disableMedianFilter() {
     _medianFilterEnabled = false;
-    
-    // Free buffer if no filters are enabled
-    if (!_averageFilterEnabled && _distanceBuffer != nullptr) {
-        delete[] _distanceBuffer;
-        _distanceBuffer = nullptr;
-        _bufferSize = 0;
-    }
+    _configureFilters();
 }
 
 void TFLunaAdvanced::enableAverageFilter(uint8_t windowSize) {
     // Limit window size to reasonable values
     if (windowSize < 2) {
         windowSize = 2;
-    } else if (windowSize > 20) {
-        windowSize = 20;
+    } else if (windowSize > TFLUNA_AVERAGE_MAX_WINDOW) {
+        windowSize = TFLUNA_AVERAGE_MAX_WINDOW;
     }
     
     _averageWindowSize = windowSize;
     _averageFilterEnabled = true;
-    
-    // Allocate or reallocate buffer if needed
-    uint8_t requiredSize = _medianFilterEnabled ? _medianWindowSize : 0;
-    requiredSize = _averageFilterEnabled ? max(requiredSize, _averageWindowSize) : requiredSize;
-    
-    if (requiredSize > _bufferSize) {
-        if (_distanceBuffer != nullptr) {
-            delete[] _distanceBuffer;
-        }
-        
-        _distanceBuffer = new uint16_t[requiredSize];
-        _bufferSize = requiredSize;
-        _bufferIndex = 0;
-        _bufferFilled = false;
-        
-        // Initialize buffer with zeros
-        for (uint8_t i = 0; i < _bufferSize; i++) {
-            _distanceBuffer[i] = 0;
-        }
-    }
+    _configureFilters();
 }
 
 void TFLunaAdvanced::disableAverageFilter() {
     _averageFilterEnabled = false;
-    
-    // Free buffer if no filters are enabled
-    if (!_medianFilterEnabled && _distanceBuffer != nullptr) {
-        delete[] _distanceBuffer;
-        _distanceBuffer = nullptr;
-        _bufferSize = 0;
-    }
+    _configureFilters();
 }
 
 // Overridden data acquisition methods to apply filters
 bool TFLunaAdvanced::getData() {
     bool result = TFLuna::getData();
     
-    if (result && (_medianFilterEnabled || _averageFilterEnabled)) {
-        uint16_t rawDistance = TFLuna::getDistance();
-        uint16_t filteredDistance = _applyFilters(rawDistance);
-        
-        // Override the distance with filtered value
-        _distance = filteredDistance;
-    }
-    
-    // Log data if logging is enabled
-    if (result && _loggingEnabled && _logStream != nullptr) {
-        _logStream->print("Distance: ");
-        _logStream->print(_distance);
-        _logStream->print(" cm, Strength: ");
-        _logStream->print(_strength);
-        _logStream->print(", Temp: ");
-        _logStream->print(_temperature / 100.0);
-        _logStream->println(" °C");
-    }
-    
-    // Check thresholds if enabled
-    if (result && _thresholdsEnabled) {
-        checkThresholds();
+    if (result) {
+        _processSample();
+    } else {
+        _logSample();
     }
     
     return result;
@@ -126,40 +93,40 @@ bool TFLunaAdvanced::getData() {
 bool TFLunaAdvanced::getDataI2C(uint8_t addr) {
     bool result = TFLuna::getDataI2C(addr);
     
-    if (result && (_medianFilterEnabled || _averageFilterEnabled)) {
-        uint16_t rawDistance = TFLuna::getDistance();
-        uint16_t filteredDistance = _applyFilters(rawDistance);
-        
-        // Override the distance with filtered value
-        _distance = filteredDistance;
-    }
-    
-    // Log data if logging is enabled
-    if (result && _loggingEnabled && _logStream != nullptr) {
-        _logStream->print("Distance: ");
-        _logStream->print(_distance);
-        _logStream->print(" cm, Strength: ");
-        _logStream->print(_strength);
-        _logStream->print(", Temp: ");
-        _logStream->print(_temperature / 100.0);
-        _logStream->println(" °C");
-    }
-    
-    // Check thresholds if enabled
-    if (result && _thresholdsEnabled) {
-        checkThresholds();
+    if (result) {
+        _processSample();
+    } else {
+        _logSample();
     }
     
     return result;
 }
 
+// Motion tracking
+void TFLunaAdvanced::enableTracking(uint16_t frameRate) {
+    _tracker.setFrameRate(frameRate);
+    _trackingEnabled = true;
+}
+
+void TFLunaAdvanced::disableTracking() {
+    _trackingEnabled = false;
+}
+
+uint16_t TFLunaAdvanced::getTrackedDistance() const {
+    return _tracker.getDistance();
+}
+
+int16_t TFLunaAdvanced::getVelocity() const {
+    return _tracker.getVelocity();
+}
+
 // Distance conversion methods
 float TFLunaAdvanced::getDistanceInMeters() const {
-    return _distance / 100.0f;
+    return distanceToMillimeters(_distance, _unit) / 1000.0f;
 }
 
 float TFLunaAdvanced::getDistanceInInches() const {
-    return _distance / 2.54f;
+    return distanceToMillimeters(_distance, _unit) / 25.4f;
 }
 
 // Temperature conversion methods
@@ -171,35 +138,78 @@ float TFLunaAdvanced::getTemperatureInFahrenheit() const {
     return (_temperature / 100.0f * 9.0f / 5.0f) + 32.0f;
 }
 
+// Fixed-point conversions
+uint32_t TFLunaAdvanced::getDistanceInMillimeters() const {
+    return distanceToMillimeters(_distance, _unit);
+}
+
+uint32_t TFLunaAdvanced::getDistanceInMetersQ16() const {
+    return distanceToMetersQ16(_distance, _unit);
+}
+
+uint32_t TFLunaAdvanced::getDistanceInInchesQ8() const {
+    return distanceToInchesQ8(_distance, _unit);
+}
+
+int32_t TFLunaAdvanced::getTemperatureInCentiFahrenheit() const {
+    return centiCelsiusToCentiFahrenheit(_temperature);
+}
+
+// Batch conversions
+void TFLunaAdvanced::toMillimeters(const Sample* samples, uint32_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = distanceToMillimeters(samples[i].distance, samples[i].unit);
+    }
+}
+
+void TFLunaAdvanced::toMetersQ16(const Sample* samples, uint32_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = distanceToMetersQ16(samples[i].distance, samples[i].unit);
+    }
+}
+
+void TFLunaAdvanced::toCentiFahrenheit(const Sample* samples, int32_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = centiCelsiusToCentiFahrenheit(samples[i].temperature);
+    }
+}
+
+void TFLunaAdvanced::toSignalQuality(const Sample* samples, uint8_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = strengthToQuality(samples[i].strength);
+    }
+}
+
 // Signal quality assessment
 bool TFLunaAdvanced::isSignalReliable() const {
     // Signal is considered reliable if strength is above 100
     // and distance is within the valid range (0.2m to 8m)
-    return (_strength > 100 && _distance >= 20 && _distance <= 800);
+    uint32_t mm = distanceToMillimeters(_distance, _unit);
+    return (_strength > 100 && mm >= 200 && mm <= 8000);
 }
 
 uint8_t TFLunaAdvanced::getSignalQuality() const {
     // Convert signal strength to a quality percentage
     // Signal strength below 30 is considered poor quality (0%)
     // Signal strength above 2000 is considered excellent quality (100%)
-    if (_strength < 30) {
-        return 0;
-    } else if (_strength > 2000) {
-        return 100;
-    } else {
-        // Linear mapping from 30-2000 to 0-100%
-        return (uint8_t)((_strength - 30) * 100 / 1970);
-    }
+    return strengthToQuality(_strength);
 }
 
 // Data logging
-void TFLunaAdvanced::beginLogging(Stream* logStream) {
-    _logStream = logStream;
-    _loggingEnabled = true;
+void TFLunaAdvanced::beginLogging(Print* logStream, uint8_t format) {
+    _logger.begin(logStream, format);
 }
 
 void TFLunaAdvanced::endLogging() {
-    _loggingEnabled = false;
+    _logger.end();
+}
+
+size_t TFLunaAdvanced::flushLog() {
+    return _logger.flush();
+}
+
+uint32_t TFLunaAdvanced::getDroppedLogRecords() const {
+    return _logger.getDroppedRecords();
 }
 
 // Distance thresholds and callbacks
@@ -246,80 +256,56 @@ bool TFLunaAdvanced::checkThresholds() {
 }
 
 // Private helper methods
-uint16_t TFLunaAdvanced::_applyFilters(uint16_t rawDistance) {
-    // Add the new distance to the buffer
-    if (_distanceBuffer != nullptr && _bufferSize > 0) {
-        _distanceBuffer[_bufferIndex] = rawDistance;
-        _bufferIndex = (_bufferIndex + 1) % _bufferSize;
-        
-        // Check if buffer is filled
-        if (!_bufferFilled && _bufferIndex == 0) {
-            _bufferFilled = true;
-        }
-    }
-    
-    // Apply filters
-    uint16_t filteredDistance = rawDistance;
-    
-    if (_medianFilterEnabled && _bufferFilled) {
-        filteredDistance = _calculateMedian();
+void TFLunaAdvanced::_processSample() {
+    // After a format change, or a reset that restored another one, the
+    // windows and the track hold values in the old unit
+    if (_unit != _processedUnit) {
+        _processedUnit = _unit;
+        _filters.reset();
+        _tracker.reset();
     }
     
-    if (_averageFilterEnabled && _bufferFilled) {
-        // If both filters are enabled, use median as input to average
-        if (_medianFilterEnabled) {
-            // We already calculated median, just use it
-        } else {
-            filteredDistance = _calculateAverage();
-        }
+    // The tracker runs on raw measurements, it does its own smoothing
+    if (_trackingEnabled) {
+        Sample sample;
+        getSample(sample);
+        _tracker.update(sample);
     }
     
-    return filteredDistance;
-}
-
-uint16_t TFLunaAdvanced::_calculateMedian() {
-    if (_distanceBuffer == nullptr || _bufferSize < _medianWindowSize) {
-        return 0;
+    if (_medianFilterEnabled || _averageFilterEnabled) {
+        uint16_t rawDistance = TFLuna::getDistance();
+        uint16_t filteredDistance = _applyFilters(rawDistance);
+        
+        // Override the distance with filtered value
+        _distance = filteredDistance;
     }
     
-    // Copy values to a temporary array for sorting
-    uint16_t tempArray[_medianWindowSize];
-    
-    // Fill the temporary array with the most recent values
-    for (uint8_t i = 0; i < _medianWindowSize; i++) {
-        uint8_t idx = (_bufferIndex - 1 - i + _bufferSize) % _bufferSize;
-        tempArray[i] = _distanceBuffer[idx];
-    }
+    _logSample();
     
-    // Simple bubble sort
-    for (uint8_t i = 0; i < _medianWindowSize - 1; i++) {
-        for (uint8_t j = 0; j < _medianWindowSize - i - 1; j++) {
-            if (tempArray[j] > tempArray[j + 1]) {
-                // Swap
-                uint16_t temp = tempArray[j];
-                tempArray[j] = tempArray[j + 1];
-                tempArray[j + 1] = temp;
-            }
-        }
+    // Check thresholds if enabled
+    if (_thresholdsEnabled) {
+        checkThresholds();
     }
-    
-    // Return the middle value
-    return tempArray[_medianWindowSize / 2];
 }
 
-uint16_t TFLunaAdvanced::_calculateAverage() {
-    if (_distanceBuffer == nullptr || _bufferSize < _averageWindowSize) {
-        return 0;
+void TFLunaAdvanced::_logSample() {
+    // Queue a record and push out what the output can take right now. Failed
+    // reads are logged too, their record carries the last good sample.
+    if (_logger.isActive()) {
+        Sample sample;
+        getSample(sample);
+        _logger.log(sample, _errorCode);
+        _logger.flush();
     }
-    
-    uint32_t sum = 0;
-    
-    // Sum the most recent values
-    for (uint8_t i = 0; i < _averageWindowSize; i++) {
-        uint8_t idx = (_bufferIndex - 1 - i + _bufferSize) % _bufferSize;
-        sum += _distanceBuffer[idx];
-    }
-    
-    // Calculate average
-    return (uint16_t)(sum / _averageWindowSize);
+}
+
+uint16_t TFLunaAdvanced::_applyFilters(uint16_t rawDistance) {
+    // Median first to reject spikes, then average its output
+    return _filters.process(rawDistance);
+}
+
+void TFLunaAdvanced::_configureFilters() {
+    // A window of one turns a stage into a pass-through
+    _filters.stage<0>().setWindow(_medianFilterEnabled ? _medianWindowSize : 1);
+    _filters.stage<1>().setWindow(_averageFilterEnabled ? _averageWindowSize : 1);
 }
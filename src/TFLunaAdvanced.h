@@ -2,6 +2,13 @@
 #define TFLUNA_ADVANCED_H
 
 #include "TFLuna.h"
+#include "TFLunaFilters.h"
+#include "TFLunaLogger.h"
+#include "TFLunaTracker.h"
+
+// Largest windows accepted by enableMedianFilter() / enableAverageFilter()
+#define TFLUNA_MEDIAN_MAX_WINDOW  15
+#define TFLUNA_AVERAGE_MAX_WINDOW 20
 
 // Advanced features for TF-Luna LiDAR sensor
 class TFLunaAdvanced : public TFLuna {
@@ -9,6 +16,11 @@ public:
     // Inherit constructors
     using TFLuna::TFLuna;
     
+    // Distance filter chain: median, then average of the median's output.
+    // A disabled stage runs with a window of one, which passes values through.
+    typedef TFLunaFilterPipeline<TFLunaMedianFilter<TFLUNA_MEDIAN_MAX_WINDOW>,
+                                 TFLunaMeanFilter<TFLUNA_AVERAGE_MAX_WINDOW> > Filters;
+    
     // Distance filtering methods
     void enableMedianFilter(uint8_t windowSize = 5);
     void disableMedianFilter();
@@ -19,6 +31,13 @@ public:
     bool getData() override;
     bool getDataI2C(uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR) override;
     
+    // Motion tracking (fixed-point alpha-beta tracker on raw samples). Tracks
+    // in cm whatever the output format, so the velocity limit stays 20 m/s.
+    void enableTracking(uint16_t frameRate = 100);
+    void disableTracking();
+    uint16_t getTrackedDistance() const;   // cm
+    int16_t getVelocity() const;           // cm/s, positive when moving away
+    
     // Distance conversion methods
     float getDistanceInMeters() const;
     float getDistanceInInches() const;
@@ -27,15 +46,29 @@ public:
     float getTemperatureInCelsius() const;
     float getTemperatureInFahrenheit() const;
     
+    // Fixed-point conversions, no float or 32-bit divide
+    uint32_t getDistanceInMillimeters() const;
+    uint32_t getDistanceInMetersQ16() const;       // Meters in 16.16 fixed point
+    uint32_t getDistanceInInchesQ8() const;        // Inches in 24.8 fixed point
+    int32_t getTemperatureInCentiFahrenheit() const; // 0.01°F
+    
+    // Batch conversions over arrays of samples
+    static void toMillimeters(const Sample* samples, uint32_t* out, size_t count);
+    static void toMetersQ16(const Sample* samples, uint32_t* out, size_t count);
+    static void toCentiFahrenheit(const Sample* samples, int32_t* out, size_t count);
+    static void toSignalQuality(const Sample* samples, uint8_t* out, size_t count);
+    
     // Signal quality assessment
     bool isSignalReliable() const;
     uint8_t getSignalQuality() const; // 0-100%
     
-    // Data logging
-    void beginLogging(Stream* logStream);
-    void endLogging();
+    // Data logging, buffered in RAM and written without blocking
+    void beginLogging(Print* logStream, uint8_t format = TFLUNA_LOG_TEXT);
+    void endLogging();                     // Writes out what is still buffered
+    size_t flushLog();                     // Call from loop() to drain the buffer
+    uint32_t getDroppedLogRecords() const;
     
-    // Distance thresholds and callbacks
+    // Distance thresholds and callbacks, in the output unit like getDistance()
     typedef void (*DistanceCallback)(uint16_t distance);
     void setMinDistanceThreshold(uint16_t threshold, DistanceCallback callback = nullptr);
     void setMaxDistanceThreshold(uint16_t threshold, DistanceCallback callback = nullptr);
@@ -51,20 +84,24 @@ private:
     uint8_t _medianWindowSize = 5;
     uint8_t _averageWindowSize = 5;
     
-    // Filter buffers
-    uint16_t* _distanceBuffer = nullptr;
-    uint8_t _bufferIndex = 0;
-    uint8_t _bufferSize = 0;
-    bool _bufferFilled = false;
+    // Filter state
+    Filters _filters;
+    uint8_t _processedUnit = TFLUNA_UNIT_CM;   // Of the values in the filters and tracker
+    
+    // Tracker state
+    TFLunaTracker _tracker;
+    bool _trackingEnabled = false;
+    
+    // Post-process a new sample: tracking, filters, logging, thresholds
+    void _processSample();
     
     // Apply filters to raw distance
     uint16_t _applyFilters(uint16_t rawDistance);
-    uint16_t _calculateMedian();
-    uint16_t _calculateAverage();
+    void _configureFilters();
     
     // Logging
-    Stream* _logStream = nullptr;
-    bool _loggingEnabled = false;
+    TFLunaLogger _logger;
+    void _logSample();
     
     // Threshold settings
     uint16_t _minThreshold = 0;
@@ -0,0 +1,366 @@
+#include "TFLunaArray.h"
+
+TFLunaArray::TFLunaArray(TwoWire* wire) : _bus(wire) {
+    memset(_samples, 0, sizeof(_samples));
+    resetStatistics();
+}
+
+bool TFLunaArray::begin() {
+    _bus.getWire()->begin();
+    resetStatistics();
+
+    _startReady((1 << _count) - 1, TFLUNA_BOOT_TIMEOUT_MS, true);
+    return waitReady();
+}
+
+bool TFLunaArray::addSensor(uint8_t addr, uint16_t targetRate) {
+    if (_count >= TFLUNA_ARRAY_MAX_SENSORS || targetRate > TFLUNA_ARRAY_MAX_RATE) {
+        return false;
+    }
+
+    _addr[_count] = addr;
+    _period[_count] = targetRate > 0 ? 1000000UL / targetRate : 0;
+    _due[_count] = micros();
+    _errorCodes[_count] = TFLUNA_OK;
+    _reads[_count] = 0;
+    _rates[_count] = 0;
+    _errors[_count] = 0;
+    _count++;
+
+    return true;
+}
+
+uint8_t TFLunaArray::getSensorCount() const {
+    return _count;
+}
+
+uint8_t TFLunaArray::getAddress(uint8_t index) const {
+    return index < _count ? _addr[index] : 0;
+}
+
+void TFLunaArray::setSchedule(uint8_t schedule) {
+    _schedule = schedule;
+    _inFlight = 0;
+    _inFlightCount = 0;
+    _nextTrigger = 0;
+    _readNext = false;
+
+    // Restart the deadlines so rate mode does not begin with a backlog
+    uint32_t now = micros();
+    for (uint8_t i = 0; i < _count; i++) {
+        _due[i] = now;
+    }
+}
+
+uint8_t TFLunaArray::getSchedule() const {
+    return _schedule;
+}
+
+void TFLunaArray::setMeasurementTime(uint32_t measureMicros) {
+    _measureMicros = measureMicros;
+}
+
+void TFLunaArray::setMaxInFlight(uint8_t count) {
+    _maxInFlight = count;
+}
+
+uint8_t TFLunaArray::update() {
+    uint32_t now = micros();
+    _updateStatistics(now);
+
+    if (_schedule == TFLUNA_ARRAY_TRIGGERED) {
+        return _updateTriggered(now);
+    }
+
+    uint8_t index = _nextIndex(now);
+    if (index == TFLUNA_ARRAY_NONE) {
+        return TFLUNA_ARRAY_NONE;
+    }
+
+    uint32_t end = _read(index, now);
+
+    // Next deadline; a sensor that fell a full period behind is not allowed
+    // to catch up in a burst
+    if (_period[index] > 0) {
+        _due[index] += _period[index];
+        if ((int32_t)(end - _due[index]) >= (int32_t)_period[index]) {
+            _due[index] = end + _period[index];
+        }
+    }
+
+    return index;
+}
+
+const TFLuna::Sample* TFLunaArray::getSamples() const {
+    return _samples;
+}
+
+const TFLuna::Sample& TFLunaArray::getSample(uint8_t index) const {
+    return _samples[index < _count ? index : 0];
+}
+
+uint8_t TFLunaArray::getErrorCode(uint8_t index) const {
+    return index < _count ? _errorCodes[index] : TFLUNA_ERROR_INVALID_PARAM;
+}
+
+uint8_t TFLunaArray::takeUpdatedMask() {
+    uint8_t updated = _updated;
+    _updated = 0;
+    return updated;
+}
+
+// Readiness
+bool TFLunaArray::startReset() {
+    bool result = true;
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_resetSensor(_addr[i], _errorCodes[i])) {
+            mask |= 1 << i;
+        } else {
+            _errors[i]++;
+            result = false;
+        }
+    }
+
+    _startReady(mask, TFLUNA_RESET_TIMEOUT_MS, false);
+    return result;
+}
+
+uint8_t TFLunaArray::pollReady() {
+    if (_readyState != TFLUNA_READY_WAITING) {
+        return _readyState;
+    }
+
+    uint32_t now = millis();
+    if (now - _readyProbe >= TFLUNA_READY_POLL_MS) {
+        _readyProbe = now;
+        for (uint8_t i = 0; i < _count; i++) {
+            if ((_waiting & (1 << i)) && _probeSensor(_addr[i])) {
+                _waiting &= ~(1 << i);
+                _errorCodes[i] = TFLUNA_OK;
+            }
+        }
+    }
+
+    if (_waiting == 0) {
+        _readyState = TFLUNA_READY_OK;
+    } else if (now - _readyStart >= _readyTimeout) {
+        for (uint8_t i = 0; i < _count; i++) {
+            if (_waiting & (1 << i)) {
+                _errorCodes[i] = TFLUNA_ERROR_TIMEOUT;
+                _errors[i]++;
+            }
+        }
+        _readyState = TFLUNA_READY_FAILED;
+    }
+    return _readyState;
+}
+
+bool TFLunaArray::waitReady() {
+    uint8_t state = pollReady();
+    while (state == TFLUNA_READY_WAITING) {
+        state = pollReady();
+    }
+    return state != TFLUNA_READY_FAILED;
+}
+
+// Statistics
+uint16_t TFLunaArray::getAchievedRate(uint8_t index) const {
+    return index < _count ? _rates[index] : 0;
+}
+
+uint32_t TFLunaArray::getErrorCount(uint8_t index) const {
+    return index < _count ? _errors[index] : 0;
+}
+
+uint8_t TFLunaArray::getBusUtilisation() const {
+    return _utilisation;
+}
+
+void TFLunaArray::resetStatistics() {
+    for (uint8_t i = 0; i < _count; i++) {
+        _reads[i] = 0;
+        _rates[i] = 0;
+        _errors[i] = 0;
+    }
+    _windowStart = micros();
+    _busyMicros = 0;
+    _utilisation = 0;
+}
+
+TFLuna& TFLunaArray::getBus() {
+    return _bus;
+}
+
+// Default read hook: one 8-byte burst through the shared TFLuna instance
+bool TFLunaArray::_readSensor(uint8_t addr, TFLuna::Sample &sample, uint8_t &errorCode) {
+    bool result = _bus.getDataI2C(addr);
+    if (result) {
+        _bus.getSample(sample);
+    }
+    errorCode = _bus.getErrorCode();
+    return result;
+}
+
+bool TFLunaArray::_triggerSensor(uint8_t addr, uint8_t &errorCode) {
+    bool result = _bus.triggerSampleI2C(addr);
+    errorCode = _bus.getErrorCode();
+    return result;
+}
+
+// Default reset and probe hooks; the bus instance tracks the readiness of
+// one device only, so the array keeps its own
+bool TFLunaArray::_resetSensor(uint8_t addr, uint8_t &errorCode) {
+    bool result = _bus.startSoftResetI2C(addr);
+    errorCode = _bus.getErrorCode();
+    return result;
+}
+
+bool TFLunaArray::_probeSensor(uint8_t addr) {
+    return _bus.pingI2C(addr);
+}
+
+// Private helper methods
+uint32_t TFLunaArray::_read(uint8_t index, uint32_t start) {
+    TFLuna::Sample sample;
+    uint8_t errorCode = TFLUNA_OK;
+    bool result = _readSensor(_addr[index], sample, errorCode);
+    uint32_t end = micros();
+    _busyMicros += end - start;
+
+    if (result) {
+        sample.sequence = _samples[index].sequence + 1;
+        _samples[index] = sample;
+        _reads[index]++;
+    } else {
+        _samples[index].sequence++;  // Keep the gap visible
+        _errors[index]++;
+    }
+    _errorCodes[index] = errorCode;
+    _updated |= 1 << index;
+    _last = index;
+
+    return end;
+}
+
+uint8_t TFLunaArray::_updateTriggered(uint32_t now) {
+    // Sensor whose measurement finished first
+    uint8_t ready = TFLUNA_ARRAY_NONE;
+    int32_t longestWait = -1;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (!(_inFlight & (1 << i))) {
+            continue;
+        }
+        int32_t waited = (int32_t)(now - _triggeredAt[i]);
+        if (waited >= (int32_t)_measureMicros && waited > longestWait) {
+            ready = i;
+            longestWait = waited;
+        }
+    }
+
+    // Keep the pipeline full: a finished read is followed by a new trigger,
+    // so one sensor integrates while the next is read. Alternating also stops
+    // a sensor that keeps failing its trigger from starving the reads.
+    uint8_t maxInFlight = (_maxInFlight == 0 || _maxInFlight > _count) ? _count : _maxInFlight;
+    bool canTrigger = _count > 0 && _inFlightCount < maxInFlight;
+
+    if (ready != TFLUNA_ARRAY_NONE && (_readNext || !canTrigger)) {
+        _inFlight &= ~(1 << ready);
+        _inFlightCount--;
+        _readNext = false;
+        _read(ready, now);
+        return ready;
+    }
+
+    if (canTrigger) {
+        _trigger(now);
+        _readNext = true;
+    }
+
+    return TFLUNA_ARRAY_NONE;
+}
+
+void TFLunaArray::_trigger(uint32_t start) {
+    // Next idle sensor in turn; there is one while fewer than all are measuring
+    uint8_t i = _nextTrigger;
+    while (_inFlight & (1 << i)) {
+        i = i + 1 >= _count ? 0 : i + 1;
+    }
+
+    uint8_t errorCode = TFLUNA_OK;
+    bool result = _triggerSensor(_addr[i], errorCode);
+    uint32_t end = micros();
+    _busyMicros += end - start;
+
+    if (result) {
+        _inFlight |= 1 << i;
+        _inFlightCount++;
+        _triggeredAt[i] = end;
+    } else {
+        _errorCodes[i] = errorCode;
+        _errors[i]++;
+    }
+    _nextTrigger = i + 1 >= _count ? 0 : i + 1;
+}
+
+uint8_t TFLunaArray::_nextIndex(uint32_t now) {
+    if (_count == 0) {
+        return TFLUNA_ARRAY_NONE;
+    }
+
+    if (_schedule == TFLUNA_ARRAY_ROUND_ROBIN) {
+        return _last + 1 >= _count ? 0 : _last + 1;
+    }
+
+    // Earliest deadline first among paced sensors that are due
+    uint8_t best = TFLUNA_ARRAY_NONE;
+    int32_t bestLate = -1;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_period[i] == 0) {
+            continue;
+        }
+        int32_t late = (int32_t)(now - _due[i]);
+        if (late > bestLate) {
+            best = i;
+            bestLate = late;
+        }
+    }
+    if (best != TFLUNA_ARRAY_NONE) {
+        return best;
+    }
+
+    // Otherwise the next unpaced sensor in turn gets the free bus
+    for (uint8_t step = 1; step <= _count; step++) {
+        uint8_t i = (_last + step) % _count;
+        if (_period[i] == 0) {
+            return i;
+        }
+    }
+
+    return TFLUNA_ARRAY_NONE;
+}
+
+void TFLunaArray::_updateStatistics(uint32_t now) {
+    uint32_t elapsed = now - _windowStart;
+    if (elapsed < TFLUNA_ARRAY_STATS_WINDOW_MS * 1000UL) {
+        return;
+    }
+
+    // Divides only once per window
+    for (uint8_t i = 0; i < _count; i++) {
+        _rates[i] = (uint32_t)_reads[i] * 1000000UL / elapsed;
+        _reads[i] = 0;
+    }
+    uint32_t percent = _busyMicros / (elapsed / 100);
+    _utilisation = percent > 100 ? 100 : percent;
+    _windowStart = now;
+    _busyMicros = 0;
+}
+
+void TFLunaArray::_startReady(uint8_t mask, uint16_t timeoutMs, bool probeNow) {
+    _waiting = mask;
+    _readyTimeout = timeoutMs;
+    _readyStart = millis();
+    _readyProbe = probeNow ? _readyStart - TFLUNA_READY_POLL_MS : _readyStart;
+    _readyState = TFLUNA_READY_WAITING;
+}
@@ -0,0 +1,147 @@
+#ifndef TFLUNA_ARRAY_H
+#define TFLUNA_ARRAY_H
+
+#include "TFLuna.h"
+
+// Sensors one array can schedule; also the width of the updated mask
+#define TFLUNA_ARRAY_MAX_SENSORS     8
+
+// Scheduling policies
+#define TFLUNA_ARRAY_ROUND_ROBIN     0   // Read the sensors in turn, back to back
+#define TFLUNA_ARRAY_RATE            1   // Read each sensor at its target rate
+#define TFLUNA_ARRAY_TRIGGERED       2   // Pipelined trigger-mode acquisition
+
+// Highest target rate, the frame rate limit of the sensor
+#define TFLUNA_ARRAY_MAX_RATE        250
+
+// Returned by update() when no read was due
+#define TFLUNA_ARRAY_NONE            0xFF
+
+// Default time from a trigger until the measurement can be read
+#define TFLUNA_ARRAY_MEASURE_US      4000
+
+// Period over which achieved rates and bus utilisation are measured
+#define TFLUNA_ARRAY_STATS_WINDOW_MS 1000
+
+// Scheduler for several TF-Luna sensors sharing one I2C bus.
+//
+// Each call to update() performs at most one burst read, on the sensor that is
+// next in turn (round robin) or whose deadline has passed by the most (rate
+// mode), and stores the result in a shared sample array indexed like
+// addSensor() calls. Calling update() from loop() without delays keeps the bus
+// busy up to its limit; in rate mode idle time is left to the application.
+//
+// In triggered mode the sensors must be in trigger mode (setTriggerModeI2C()).
+// Each update() is one bus operation: reading the sensor whose measurement
+// finished first, or triggering the next idle sensor. Reads and triggers
+// alternate while both are possible, so sensor k+1 integrates while sensor k
+// is being read and the bus is not left idle waiting for one measurement.
+// setMaxInFlight() bounds how many sensors measure at once, e.g. 1 for
+// sensors whose fields of view overlap.
+//
+// The array keeps its own per-sensor sequence numbers, so gaps in
+// Sample::sequence are per sensor, as for a single TFLuna.
+class TFLunaArray {
+public:
+    TFLunaArray(TwoWire* wire = &Wire);  // Sensors on one I2C controller
+    virtual ~TFLunaArray() {}
+
+    // Starts the I2C bus and waits for the sensors added so far to answer,
+    // at most TFLUNA_BOOT_TIMEOUT_MS; false when one of them does not
+    bool begin();
+
+    // Register a sensor; targetRate in Hz, 0 reads it whenever the bus is free.
+    // Returns false when the array is full or the rate is out of range.
+    bool addSensor(uint8_t addr, uint16_t targetRate = 0);
+    uint8_t getSensorCount() const;
+    uint8_t getAddress(uint8_t index) const;
+
+    void setSchedule(uint8_t schedule);
+    uint8_t getSchedule() const;
+
+    // Triggered mode settings
+    void setMeasurementTime(uint32_t measureMicros);  // Trigger to readable, us
+    void setMaxInFlight(uint8_t count);          // Sensors measuring at once, 0 for all
+
+    // Perform the next due bus operation. Returns the index of the sensor
+    // read, or TFLUNA_ARRAY_NONE when nothing was due or only a trigger was sent.
+    uint8_t update();
+
+    // Shared results, one entry per sensor
+    const TFLuna::Sample* getSamples() const;
+    const TFLuna::Sample& getSample(uint8_t index) const;
+    uint8_t getErrorCode(uint8_t index) const;   // Result of the last read
+    uint8_t takeUpdatedMask();                   // Sensors read since the last call, bit per index
+
+    // Readiness. startReset() soft-resets every sensor back to back and
+    // pollReady() probes the ones not answering yet, so the whole array
+    // restarts in the time of the slowest sensor. A sensor that misses the
+    // deadline keeps TFLUNA_ERROR_TIMEOUT as its error code.
+    bool startReset();                           // False when a reset was not acknowledged
+    uint8_t pollReady();                         // TFLUNA_READY_*
+    bool waitReady();
+
+    // Statistics over the last TFLUNA_ARRAY_STATS_WINDOW_MS
+    uint16_t getAchievedRate(uint8_t index) const;   // Successful reads per second
+    uint32_t getErrorCount(uint8_t index) const;     // Failed reads since reset
+    uint8_t getBusUtilisation() const;               // Percent of time spent in reads
+    void resetStatistics();
+
+    // Register access for configuration, e.g. getBus().setFrameRateI2C(250, addr)
+    TFLuna& getBus();
+
+protected:
+    // One burst read of the device at addr. Overridden to run the scheduler
+    // without hardware.
+    virtual bool _readSensor(uint8_t addr, TFLuna::Sample &sample, uint8_t &errorCode);
+    virtual bool _triggerSensor(uint8_t addr, uint8_t &errorCode);
+    virtual bool _resetSensor(uint8_t addr, uint8_t &errorCode);
+    virtual bool _probeSensor(uint8_t addr);
+
+private:
+    uint8_t _nextIndex(uint32_t now);
+    uint8_t _updateTriggered(uint32_t now);
+    void _trigger(uint32_t start);
+    uint32_t _read(uint8_t index, uint32_t start);
+    void _updateStatistics(uint32_t now);
+    void _startReady(uint8_t mask, uint16_t timeoutMs, bool probeNow);
+
+    TFLuna _bus;
+    uint8_t _schedule = TFLUNA_ARRAY_ROUND_ROBIN;
+    uint8_t _count = 0;
+    uint8_t _last = TFLUNA_ARRAY_MAX_SENSORS - 1;
+    uint8_t _updated = 0;
+
+    // Trigger pipeline
+    uint32_t _measureMicros = TFLUNA_ARRAY_MEASURE_US;
+    uint8_t _maxInFlight = 0;
+    uint8_t _inFlight = 0;                          // Bit per sensor measuring
+    uint8_t _inFlightCount = 0;
+    uint8_t _nextTrigger = 0;
+    bool _readNext = false;                         // Last operation was a trigger
+
+    // Readiness wait
+    uint8_t _readyState = TFLUNA_READY_IDLE;
+    uint8_t _waiting = 0;                           // Bit per sensor not answering yet
+    uint16_t _readyTimeout = 0;
+    uint32_t _readyStart = 0;                       // millis()
+    uint32_t _readyProbe = 0;
+
+    // Per sensor
+    uint8_t _addr[TFLUNA_ARRAY_MAX_SENSORS];
+    uint32_t _period[TFLUNA_ARRAY_MAX_SENSORS];     // us, 0 when unpaced
+    uint32_t _due[TFLUNA_ARRAY_MAX_SENSORS];        // micros() of the next read
+    uint32_t _triggeredAt[TFLUNA_ARRAY_MAX_SENSORS];
+    TFLuna::Sample _samples[TFLUNA_ARRAY_MAX_SENSORS];
+    uint8_t _errorCodes[TFLUNA_ARRAY_MAX_SENSORS];
+    uint16_t _reads[TFLUNA_ARRAY_MAX_SENSORS];      // In the current window
+    uint16_t _rates[TFLUNA_ARRAY_MAX_SENSORS];      // Of the last window
+    uint32_t _errors[TFLUNA_ARRAY_MAX_SENSORS];
+
+    // Bus statistics
+    uint32_t _windowStart = 0;
+    uint32_t _busyMicros = 0;
+    uint8_t _utilisation = 0;
+};
+
+#endif // TFLUNA_ARRAY_H
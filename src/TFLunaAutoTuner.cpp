@@ -0,0 +1,229 @@
+#include "TFLunaAutoTuner.h"
+
+// Rate ladder, Hz
+static const uint8_t tunerRates[TFLUNA_TUNER_RATE_COUNT] = {
+    1, 2, 5, 10, 20, 25, 50, 100, 125, 250
+};
+
+TFLunaAutoTuner::TFLunaAutoTuner(TFLuna &sensor, uint8_t addr) : _sensor(sensor), _addr(addr) {
+}
+
+void TFLunaAutoTuner::setLatencyTarget(uint32_t latencyMicros) {
+    _latencyMicros = latencyMicros;
+}
+
+void TFLunaAutoTuner::setCpuBudget(uint8_t percent) {
+    _cpuBudget = percent > 100 ? 100 : percent;
+}
+
+void TFLunaAutoTuner::setRateLimits(uint16_t minRate, uint16_t maxRate) {
+    _minRate = minRate;
+    _maxRate = maxRate;
+}
+
+void TFLunaAutoTuner::setWindow(uint16_t windowMs) {
+    _windowMs = windowMs > 0 ? windowMs : 1;
+}
+
+void TFLunaAutoTuner::setLog(Print* log) {
+    _log = log;
+}
+
+bool TFLunaAutoTuner::begin(uint16_t initialRate) {
+    // Highest ladder rate not above the request, within the limits
+    uint8_t index = 0;
+    while (index + 1 < TFLUNA_TUNER_RATE_COUNT && tunerRates[index + 1] <= initialRate) {
+        index++;
+    }
+    if (index < _minIndex()) {
+        index = _minIndex();
+    }
+    if (index > _maxIndex()) {
+        index = _maxIndex();
+    }
+
+    _index = index;
+    _pending = 0;
+    _confirmations = 0;
+    _settling = false;
+    _ceiling = TFLUNA_TUNER_RATE_COUNT;
+    _backoff = 0;
+    _windowStart = millis();
+    _samples = 0;
+    _busyMicros = 0;
+    _haveTimestamp = false;
+
+    return _applyRate(tunerRates[_index]);
+}
+
+void TFLunaAutoTuner::recordSample(const TFLuna::Sample &sample, uint32_t processMicros) {
+    _busyMicros += processMicros;
+
+    // I2C reads faster than the frame rate see the same measurement again
+    if (sample.timestamp != 0) {
+        if (_haveTimestamp && sample.timestamp == _lastTimestamp) {
+            return;
+        }
+        _lastTimestamp = sample.timestamp;
+        _haveTimestamp = true;
+    }
+    _samples++;
+}
+
+bool TFLunaAutoTuner::update() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - _windowStart;
+    if (elapsed < _windowMs) {
+        return false;
+    }
+
+    // Close the window
+    uint16_t rate = tunerRates[_index];
+    uint32_t expected = (uint32_t)rate * elapsed / 1000;
+    uint32_t lost = expected > _samples ? expected - _samples : 0;
+    uint32_t cpu = _busyMicros / (elapsed * 10);
+    _deliveredRate = _samples * 1000 / elapsed;
+    _dropPercent = expected > 0 ? lost * 100 / expected : 0;
+    _cpuPercent = cpu > 100 ? 100 : cpu;
+    _windowStart = now;
+    _samples = 0;
+    _busyMicros = 0;
+
+    if (_backoff > 0 && --_backoff == 0) {
+        _ceiling = TFLUNA_TUNER_RATE_COUNT;
+    }
+
+    // The window in which the rate changed mixes both rates
+    if (_settling) {
+        _settling = false;
+        return false;
+    }
+
+    bool overloaded = _dropPercent > TFLUNA_TUNER_MAX_DROP_PERCENT || cpu > _cpuBudget;
+    int8_t direction = overloaded ? -1 : _decide(cpu);
+    if (direction < 0 && _index <= _minIndex()) {
+        direction = 0;
+    }
+
+    if (direction == 0) {
+        _pending = 0;
+        _confirmations = 0;
+        return false;
+    }
+    if (direction != _pending) {
+        _pending = direction;
+        _confirmations = 0;
+    }
+    if (++_confirmations < TFLUNA_TUNER_CONFIRM_WINDOWS) {
+        return false;
+    }
+
+    // A rate the consumer could not keep up with is not retried right away
+    if (overloaded) {
+        _ceiling = _index;
+        _backoff = TFLUNA_TUNER_BACKOFF_WINDOWS;
+    }
+    return _step(direction);
+}
+
+uint16_t TFLunaAutoTuner::getFrameRate() const {
+    return tunerRates[_index];
+}
+
+uint16_t TFLunaAutoTuner::getDeliveredRate() const {
+    return _deliveredRate;
+}
+
+uint8_t TFLunaAutoTuner::getDropPercent() const {
+    return _dropPercent;
+}
+
+uint8_t TFLunaAutoTuner::getCpuPercent() const {
+    return _cpuPercent;
+}
+
+uint32_t TFLunaAutoTuner::getAdjustmentCount() const {
+    return _adjustments;
+}
+
+// Default rate hook: the frame rate command of the sensor's mode
+bool TFLunaAutoTuner::_applyRate(uint16_t rate) {
+    if (_sensor.getMode() == TFLUNA_I2C_MODE) {
+        return _sensor.setFrameRateI2C(rate, _addr);
+    }
+    return _sensor.setFrameRate(rate);
+}
+
+// Private helper methods
+int8_t TFLunaAutoTuner::_decide(uint32_t cpuPercent) const {
+    // Next rate up, if allowed and it fits the budget with headroom
+    uint8_t next = _index + 1;
+    bool canStepUp = next <= _maxIndex() && next < _ceiling &&
+                     cpuPercent * tunerRates[next] * 100 <
+                     (uint32_t)_cpuBudget * TFLUNA_TUNER_HEADROOM_PERCENT * tunerRates[_index];
+
+    if (_latencyMicros == 0) {
+        return canStepUp ? 1 : 0;
+    }
+
+    // Lowest rate whose frame period meets the target
+    if (1000000UL / tunerRates[_index] > _latencyMicros) {
+        return canStepUp ? 1 : 0;
+    }
+    if (_index > _minIndex() && 1000000UL / tunerRates[_index - 1] <= _latencyMicros) {
+        return -1;
+    }
+    return 0;
+}
+
+bool TFLunaAutoTuner::_step(int8_t direction) {
+    uint8_t from = _index;
+    uint8_t to = _index + direction;
+    _pending = 0;
+    _confirmations = 0;
+
+    if (!_applyRate(tunerRates[to])) {
+        return false;
+    }
+
+    _index = to;
+    _adjustments++;
+    _settling = true;
+    _logStep(tunerRates[from], tunerRates[to]);
+    return true;
+}
+
+void TFLunaAutoTuner::_logStep(uint16_t from, uint16_t to) const {
+    if (_log == nullptr) {
+        return;
+    }
+
+    // One line per step with the window that caused it
+    _log->print("TFLunaAutoTuner: ");
+    _log->print(from);
+    _log->print(" -> ");
+    _log->print(to);
+    _log->print(" Hz, delivered ");
+    _log->print(_deliveredRate);
+    _log->print(" Hz, drops ");
+    _log->print(_dropPercent);
+    _log->print("%, cpu ");
+    _log->print(_cpuPercent);
+    _log->println("%");
+}
+
+uint8_t TFLunaAutoTuner::_minIndex() const {
+    uint8_t index = 0;
+    while (index < _maxIndex() && tunerRates[index] < _minRate) {
+        index++;
+    }
+    return index;
+}
+
+uint8_t TFLunaAutoTuner::_maxIndex() const {
+    uint8_t index = TFLUNA_TUNER_RATE_COUNT - 1;
+    while (index > 0 && tunerRates[index] > _maxRate) {
+        index--;
+    }
+    return index;
+}
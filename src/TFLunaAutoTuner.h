@@ -0,0 +1,122 @@
+#ifndef TFLUNA_AUTO_TUNER_H
+#define TFLUNA_AUTO_TUNER_H
+
+#include "TFLuna.h"
+
+// Frame rates the tuner steps between, divisors of the 500 Hz internal rate
+#define TFLUNA_TUNER_RATE_COUNT        10
+
+// Measurement window; each decision uses one full window
+#define TFLUNA_TUNER_WINDOW_MS         1000
+
+// Windows in a row that must call for the same step before it is taken
+#define TFLUNA_TUNER_CONFIRM_WINDOWS   2
+
+// Windows a rate that overloaded the consumer stays out of reach
+#define TFLUNA_TUNER_BACKOFF_WINDOWS   10
+
+// Frames lost, in percent of those the sensor sent, that count as overload
+#define TFLUNA_TUNER_MAX_DROP_PERCENT  2
+
+// A step up is only taken when the projected processing time stays below
+// this share of the budget, which leaves a dead band against oscillation
+#define TFLUNA_TUNER_HEADROOM_PERCENT  80
+
+// Closed-loop frame rate control.
+//
+// The consumer reports every sample it handles with recordSample(), together
+// with the time it spent on it. At the end of each window update() compares
+// what the sensor was asked for with what arrived:
+//
+//   delivered rate  samples recorded per second
+//   drop rate       frames the sensor sent at its rate that never arrived
+//   CPU load        processing time per second of wall time
+//
+// and moves the device frame rate one step along a fixed ladder:
+//
+//   down  when frames are dropped or the CPU budget is exceeded, or when a
+//         lower rate still meets the latency target
+//   up    when the latency target is not met, or, without a target, while
+//         the next rate fits the budget with TFLUNA_TUNER_HEADROOM_PERCENT
+//
+// A step needs TFLUNA_TUNER_CONFIRM_WINDOWS agreeing windows, the window after
+// a step is discarded while the rate settles, and a rate that overloaded the
+// consumer is not retried for TFLUNA_TUNER_BACKOFF_WINDOWS windows. Each step
+// is written to the log output as one line.
+class TFLunaAutoTuner {
+public:
+    // Rates are set with setFrameRate() in UART mode, setFrameRateI2C(addr)
+    // in I2C mode
+    TFLunaAutoTuner(TFLuna &sensor, uint8_t addr = TFLUNA_DEFAULT_I2C_ADDR);
+    virtual ~TFLunaAutoTuner() {}
+
+    // Goals. With a latency target the tuner looks for the lowest rate whose
+    // frame period meets it; without one it runs as fast as the budget allows.
+    void setLatencyTarget(uint32_t latencyMicros);   // 0 for none
+    void setCpuBudget(uint8_t percent);              // Processing share, default 50
+    void setRateLimits(uint16_t minRate, uint16_t maxRate);
+    void setWindow(uint16_t windowMs);
+    void setLog(Print* log);                         // nullptr to stop logging
+
+    // Sets the starting rate, rounded down to the ladder
+    bool begin(uint16_t initialRate);
+
+    // Report one sample and the consumer time spent on it, in us. On I2C a
+    // sample whose device tick did not change is a repeat and is not counted.
+    void recordSample(const TFLuna::Sample &sample, uint32_t processMicros);
+
+    // Evaluate at the end of a window. Returns true when the rate changed.
+    bool update();
+
+    // Current state, measurements of the last complete window
+    uint16_t getFrameRate() const;
+    uint16_t getDeliveredRate() const;               // Samples per second
+    uint8_t getDropPercent() const;
+    uint8_t getCpuPercent() const;
+    uint32_t getAdjustmentCount() const;
+
+protected:
+    // Apply a rate to the device. Overridden to run the tuner without hardware.
+    virtual bool _applyRate(uint16_t rate);
+
+private:
+    int8_t _decide(uint32_t cpuPercent) const;
+    bool _step(int8_t direction);
+    void _logStep(uint16_t from, uint16_t to) const;
+    uint8_t _minIndex() const;
+    uint8_t _maxIndex() const;
+
+    TFLuna &_sensor;
+    uint8_t _addr;
+    Print* _log = nullptr;
+
+    // Goals
+    uint32_t _latencyMicros = 0;
+    uint8_t _cpuBudget = 50;
+    uint16_t _minRate = 1;
+    uint16_t _maxRate = 250;
+    uint16_t _windowMs = TFLUNA_TUNER_WINDOW_MS;
+
+    // Rate and hysteresis
+    uint8_t _index = 0;                   // Into the rate ladder
+    int8_t _pending = 0;                  // Direction the last windows asked for
+    uint8_t _confirmations = 0;
+    bool _settling = false;
+    uint8_t _ceiling = TFLUNA_TUNER_RATE_COUNT;   // Ladder index kept out of reach
+    uint8_t _backoff = 0;
+    uint32_t _adjustments = 0;
+
+    // Current window
+    uint32_t _windowStart = 0;
+    uint32_t _samples = 0;
+    uint32_t _busyMicros = 0;
+    uint16_t _lastTimestamp = 0;
+    bool _haveTimestamp = false;
+
+    // Last complete window
+    uint16_t _deliveredRate = 0;
+    uint8_t _dropPercent = 0;
+    uint8_t _cpuPercent = 0;
+};
+
+#endif // TFLUNA_AUTO_TUNER_H
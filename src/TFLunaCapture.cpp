@@ -0,0 +1,232 @@
+#include "TFLunaCapture.h"
+
+// LEB128 varint, returns the bytes written (at most 5)
+static uint8_t writeVarint(uint8_t* out, uint32_t value) {
+    uint8_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+TFLunaRecorder::TFLunaRecorder(Stream* source) : _source(source) {
+}
+
+bool TFLunaRecorder::begin(Print* output, uint32_t baudRate) {
+    uint8_t header[TFLUNA_CAPTURE_HEADER_LENGTH];
+    memcpy(header, TFLUNA_CAPTURE_MAGIC, 4);
+    header[4] = TFLUNA_CAPTURE_VERSION;
+    for (uint8_t i = 0; i < 4; i++) {
+        header[5 + i] = (baudRate >> (8 * i)) & 0xFF;
+    }
+
+    _output = nullptr;
+    if (output == nullptr || output->write(header, sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+
+    _output = output;
+    _chunkLength = 0;
+    _lastChunkStart = micros();
+    _recorded = 0;
+    _dropped = 0;
+    return true;
+}
+
+void TFLunaRecorder::end() {
+    if (_output != nullptr && _chunkLength > 0) {
+        _writeChunk();
+    }
+    _output = nullptr;
+}
+
+bool TFLunaRecorder::isRecording() const {
+    return _output != nullptr;
+}
+
+uint32_t TFLunaRecorder::getRecordedBytes() const {
+    return _recorded;
+}
+
+uint32_t TFLunaRecorder::getDroppedBytes() const {
+    return _dropped;
+}
+
+int TFLunaRecorder::available() {
+    return _source->available();
+}
+
+int TFLunaRecorder::read() {
+    int byte = _source->read();
+    if (byte < 0 || _output == nullptr) {
+        return byte;
+    }
+
+    // A pause or a full chunk starts the next one
+    uint32_t now = micros();
+    if (_chunkLength > 0 &&
+        (_chunkLength == TFLUNA_CAPTURE_CHUNK_MAX || now - _lastByte > TFLUNA_CAPTURE_GAP_US)) {
+        _writeChunk();
+    }
+    if (_chunkLength == 0) {
+        _chunkStart = now;
+    }
+    _chunk[_chunkLength++] = byte;
+    _lastByte = now;
+
+    return byte;
+}
+
+int TFLunaRecorder::peek() {
+    return _source->peek();
+}
+
+size_t TFLunaRecorder::write(uint8_t data) {
+    return _source->write(data);
+}
+
+size_t TFLunaRecorder::write(const uint8_t* buffer, size_t size) {
+    return _source->write(buffer, size);
+}
+
+void TFLunaRecorder::_writeChunk() {
+    // One write per chunk, so a file output sees few large writes
+    uint8_t record[5 + 1 + TFLUNA_CAPTURE_CHUNK_MAX];
+    uint8_t length = writeVarint(record, _chunkStart - _lastChunkStart);
+    record[length++] = _chunkLength;
+    memcpy(&record[length], _chunk, _chunkLength);
+    length += _chunkLength;
+
+    if (_output->write(record, length) == length) {
+        _recorded += _chunkLength;
+    } else {
+        _dropped += _chunkLength;
+    }
+    _lastChunkStart = _chunkStart;
+    _chunkLength = 0;
+}
+
+// Replay
+bool TFLunaReplayStream::begin(const uint8_t* capture, size_t length, bool realTime) {
+    _capture = NULL;
+    _length = 0;
+    if (capture == NULL || length < TFLUNA_CAPTURE_HEADER_LENGTH ||
+        memcmp(capture, TFLUNA_CAPTURE_MAGIC, 4) != 0 || capture[4] != TFLUNA_CAPTURE_VERSION) {
+        rewind();
+        return false;
+    }
+
+    _capture = capture;
+    _length = length;
+    _realTime = realTime;
+    _baudRate = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        _baudRate |= (uint32_t)capture[5 + i] << (8 * i);
+    }
+    rewind();
+    return true;
+}
+
+void TFLunaReplayStream::rewind() {
+    _position = _capture != NULL ? TFLUNA_CAPTURE_HEADER_LENGTH : 0;
+    _truncated = false;
+    _previousMicros = micros();
+    _chunkDelay = 0;
+    _chunkData = NULL;
+    _chunkLeft = 0;
+    _replayed = 0;
+    _written = 0;
+}
+
+bool TFLunaReplayStream::isFinished() const {
+    return _chunkLeft == 0 && _position >= _length;
+}
+
+bool TFLunaReplayStream::isTruncated() const {
+    return _truncated;
+}
+
+uint32_t TFLunaReplayStream::getBaudRate() const {
+    return _baudRate;
+}
+
+uint32_t TFLunaReplayStream::getReplayedBytes() const {
+    return _replayed;
+}
+
+uint32_t TFLunaReplayStream::getWrittenBytes() const {
+    return _written;
+}
+
+int TFLunaReplayStream::available() {
+    if (!_loadChunk()) {
+        return 0;
+    }
+    if (_realTime && micros() - _previousMicros < _chunkDelay) {
+        return 0;
+    }
+    return _chunkLeft;
+}
+
+int TFLunaReplayStream::read() {
+    if (available() == 0) {
+        return -1;
+    }
+    _chunkLeft--;
+    _replayed++;
+    return *_chunkData++;
+}
+
+int TFLunaReplayStream::peek() {
+    if (available() == 0) {
+        return -1;
+    }
+    return *_chunkData;
+}
+
+size_t TFLunaReplayStream::write(uint8_t data) {
+    _written++;
+    return 1;
+}
+
+bool TFLunaReplayStream::_loadChunk() {
+    if (_chunkLeft > 0) {
+        return true;
+    }
+    if (_position >= _length) {
+        return false;
+    }
+
+    // Time since the previous chunk
+    uint32_t delta = 0;
+    uint8_t shift = 0;
+    while (true) {
+        if (_position >= _length || shift > 28) {
+            _truncated = true;
+            _position = _length;
+            return false;
+        }
+        uint8_t byte = _capture[_position++];
+        delta |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+
+    // Byte count and the bytes; a capture cut off mid-chunk ends here
+    if (_position >= _length || _capture[_position] == 0 ||
+        _length - _position - 1 < _capture[_position]) {
+        _truncated = true;
+        _position = _length;
+        return false;
+    }
+    _chunkLeft = _capture[_position++];
+    _chunkData = &_capture[_position];
+    _position += _chunkLeft;
+    _previousMicros += _chunkDelay;
+    _chunkDelay = delta;
+    return true;
+}
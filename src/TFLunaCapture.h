@@ -0,0 +1,112 @@
+#ifndef TFLUNA_CAPTURE_H
+#define TFLUNA_CAPTURE_H
+
+#include "TFLuna.h"
+
+// Capture file: a header, then one record per burst of received bytes
+//
+//   header  "TFLC", version, baud rate (uint32, little-endian)
+//   chunk   time since the previous chunk in us (LEB128 varint),
+//           byte count (1-255), the bytes
+//
+// The first chunk's time counts from begin().
+#define TFLUNA_CAPTURE_MAGIC        "TFLC"
+#define TFLUNA_CAPTURE_VERSION      1
+#define TFLUNA_CAPTURE_HEADER_LENGTH 9
+
+// A chunk ends when it is full or the next byte is read this much later than
+// the previous one; its bytes are replayed together at its start time
+#define TFLUNA_CAPTURE_CHUNK_MAX    32
+#define TFLUNA_CAPTURE_GAP_US       100
+
+// Records the bytes a TFLuna reads from its UART, with their arrival times.
+//
+// The recorder is a Stream placed between the port and the sensor:
+//
+//     TFLunaRecorder recorder(&Serial1);
+//     TFLuna tfLuna(&recorder);
+//     recorder.begin(&file, 115200);
+//
+// Every byte the parser reads is passed through unchanged and appended to the
+// capture; commands written by the library go to the port and are not
+// recorded. Arrival time is the time the parser read the byte, which is as
+// close as the application can observe it.
+class TFLunaRecorder : public Stream {
+public:
+    TFLunaRecorder(Stream* source);
+
+    // Start a capture on output, writing the header; baudRate is stored for
+    // the replay
+    bool begin(Print* output, uint32_t baudRate = TFLUNA_DEFAULT_BAUD);
+    void end();                              // Write the pending chunk and stop
+    bool isRecording() const;
+
+    uint32_t getRecordedBytes() const;
+    uint32_t getDroppedBytes() const;        // Bytes the output did not take
+
+    // Stream
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+private:
+    void _writeChunk();
+
+    Stream* _source;
+    Print* _output = nullptr;
+    uint8_t _chunk[TFLUNA_CAPTURE_CHUNK_MAX];
+    uint8_t _chunkLength = 0;
+    uint32_t _chunkStart = 0;                // micros() of the chunk's first byte
+    uint32_t _lastChunkStart = 0;            // Of the chunk written before
+    uint32_t _lastByte = 0;                  // micros() of the last byte read
+    uint32_t _recorded = 0;
+    uint32_t _dropped = 0;
+};
+
+// Plays a capture back as a Stream, for regression tests and benchmarks on
+// the host. Bytes become available at their recorded times in real time
+// mode, or all at once as fast as the reader takes them. Bytes written to
+// the stream (commands) are counted and discarded.
+class TFLunaReplayStream : public Stream {
+public:
+    // The capture stays owned by the caller. False when the header is not
+    // a capture header.
+    bool begin(const uint8_t* capture, size_t length, bool realTime = false);
+    void rewind();                           // From the start, the clock restarts
+
+    bool isFinished() const;                 // All bytes read
+    bool isTruncated() const;                // Capture ended inside a chunk
+    uint32_t getBaudRate() const;
+    uint32_t getReplayedBytes() const;
+    uint32_t getWrittenBytes() const;
+
+    // Stream
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t data) override;
+    using Print::write;
+
+private:
+    bool _loadChunk();
+
+    const uint8_t* _capture = NULL;
+    size_t _length = 0;
+    size_t _position = 0;                    // Next chunk record
+    bool _realTime = false;
+    bool _truncated = false;
+    uint32_t _baudRate = 0;
+    // Release time of the previous chunk and the delay to this one; kept
+    // relative so micros() wrapping during a long replay does not stall it
+    uint32_t _previousMicros = 0;
+    uint32_t _chunkDelay = 0;
+    const uint8_t* _chunkData = NULL;
+    uint8_t _chunkLeft = 0;
+    uint32_t _replayed = 0;
+    uint32_t _written = 0;
+};
+
+#endif // TFLUNA_CAPTURE_H
@@ -0,0 +1,344 @@
+#ifndef TFLUNA_FILTERS_H
+#define TFLUNA_FILTERS_H
+
+#include <Arduino.h>
+
+// Distance filter stages. Every stage provides
+//     uint16_t process(uint16_t value);
+//     void reset();
+// and keeps its state in statically sized members, so stages can be chained
+// with TFLunaFilterPipeline at compile time without heap or virtual calls.
+
+// Streaming median over the last N distances.
+//
+// Keeps the window twice: in arrival order, to know which value leaves next,
+// and sorted, so the median is a single lookup. Each sample removes the oldest
+// value and inserts the new one with a binary search and one shift of the
+// sorted array, instead of copying and re-sorting the whole window. Until the
+// window has filled the raw value is passed through.
+template <uint8_t MaxWindow>
+class TFLunaMedianFilter {
+public:
+    static_assert(MaxWindow >= 1, "Window must hold at least one value");
+
+    TFLunaMedianFilter() {
+        setWindow(MaxWindow);
+    }
+
+    // Window is forced odd and clamped to 1..MaxWindow; clears the history
+    void setWindow(uint8_t window) {
+        if (window % 2 == 0) {
+            window++;
+        }
+        if (window > MaxWindow) {
+            window = MaxWindow % 2 ? MaxWindow : MaxWindow - 1;
+        }
+        if (window < 1) {
+            window = 1;
+        }
+
+        _window = window;
+        reset();
+    }
+
+    uint8_t getWindow() const {
+        return _window;
+    }
+
+    void reset() {
+        _count = 0;
+        _oldest = 0;
+    }
+
+    bool isFilled() const {
+        return _count == _window;
+    }
+
+    uint16_t process(uint16_t value) {
+        if (_count < _window) {
+            _history[_count] = value;
+            _insert(value, _count);
+            _count++;
+            return _count == _window ? _sorted[_window / 2] : value;
+        }
+
+        // Drop the oldest value from the sorted window, then add the new one
+        uint16_t leaving = _history[_oldest];
+        _history[_oldest] = value;
+        _oldest = (_oldest + 1 == _window) ? 0 : _oldest + 1;
+
+        uint8_t pos = _lowerBound(leaving, _window);
+        memmove(&_sorted[pos], &_sorted[pos + 1], (_window - 1 - pos) * sizeof(uint16_t));
+        _insert(value, _window - 1);
+
+        return _sorted[_window / 2];
+    }
+
+private:
+    // First index in _sorted[0..length) whose value is not below value
+    uint8_t _lowerBound(uint16_t value, uint8_t length) const {
+        uint8_t low = 0;
+        uint8_t high = length;
+        while (low < high) {
+            uint8_t mid = (low + high) / 2;
+            if (_sorted[mid] < value) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // Insert into _sorted, which currently holds length values
+    void _insert(uint16_t value, uint8_t length) {
+        uint8_t pos = _lowerBound(value, length);
+        memmove(&_sorted[pos + 1], &_sorted[pos], (length - pos) * sizeof(uint16_t));
+        _sorted[pos] = value;
+    }
+
+    uint16_t _history[MaxWindow];   // Arrival order, ring indexed by _oldest
+    uint16_t _sorted[MaxWindow];    // Same values, ascending
+    uint8_t _window;
+    uint8_t _count;
+    uint8_t _oldest;
+};
+
+// Moving average over the last N distances.
+//
+// Keeps a running sum, so each sample costs one add, one subtract and one
+// divide regardless of the window. The divide is done in 16 bits whenever
+// the sum allows it, which is the common case for real distances and much
+// cheaper than a 32-bit divide on 8-bit MCUs. Until the window has filled the
+// raw value is passed through.
+template <uint8_t MaxWindow>
+class TFLunaMeanFilter {
+public:
+    static_assert(MaxWindow >= 1, "Window must hold at least one value");
+
+    TFLunaMeanFilter() {
+        setWindow(MaxWindow);
+    }
+
+    // Window is clamped to 1..MaxWindow; clears the history
+    void setWindow(uint8_t window) {
+        if (window > MaxWindow) {
+            window = MaxWindow;
+        }
+        if (window < 1) {
+            window = 1;
+        }
+
+        _window = window;
+        reset();
+    }
+
+    uint8_t getWindow() const {
+        return _window;
+    }
+
+    void reset() {
+        _sum = 0;
+        _count = 0;
+        _oldest = 0;
+    }
+
+    bool isFilled() const {
+        return _count == _window;
+    }
+
+    uint16_t process(uint16_t value) {
+        if (_count < _window) {
+            _history[_count++] = value;
+            _sum += value;
+            return _count == _window ? _mean() : value;
+        }
+
+        _sum += value;
+        _sum -= _history[_oldest];
+        _history[_oldest] = value;
+        _oldest = (_oldest + 1 == _window) ? 0 : _oldest + 1;
+
+        return _mean();
+    }
+
+private:
+    uint16_t _mean() const {
+        if (_sum <= 0xFFFF) {
+            return (uint16_t)_sum / _window;
+        }
+        return (uint16_t)(_sum / _window);
+    }
+
+    uint16_t _history[MaxWindow];   // Arrival order, ring indexed by _oldest
+    uint32_t _sum;
+    uint8_t _window;
+    uint8_t _count;
+    uint8_t _oldest;
+};
+
+// Exponential moving average with alpha = AlphaQ8 / 256.
+//
+// State is kept with 6 fractional bits so slow filters do not stall on
+// integer truncation; the update is one subtract, one multiply and a shift.
+// The first sample initialises the state.
+template <uint8_t AlphaQ8>
+class TFLunaEMAFilter {
+public:
+    static_assert(AlphaQ8 > 0, "Alpha must be above zero");
+
+    void reset() {
+        _primed = false;
+    }
+
+    uint16_t process(uint16_t value) {
+        int32_t scaled = (int32_t)value << 6;
+        if (!_primed) {
+            _state = scaled;
+            _primed = true;
+            return value;
+        }
+
+        _state += ((scaled - _state) * AlphaQ8) >> 8;
+        return (uint16_t)((_state + 32) >> 6);
+    }
+
+private:
+    int32_t _state = 0;
+    bool _primed = false;
+};
+
+// Holds the output until the input moves more than Band away from it,
+// suppressing jitter around a stationary target.
+template <uint16_t Band>
+class TFLunaDeadbandFilter {
+public:
+    void reset() {
+        _primed = false;
+    }
+
+    uint16_t process(uint16_t value) {
+        uint16_t delta = value > _output ? value - _output : _output - value;
+        if (!_primed || delta > Band) {
+            _output = value;
+            _primed = true;
+        }
+        return _output;
+    }
+
+private:
+    uint16_t _output = 0;
+    bool _primed = false;
+};
+
+// Rejects samples that jump more than MaxJump from the last accepted value and
+// repeats that value instead. After MaxRejects consecutive rejections the new
+// level is accepted, so genuine steps get through with a short delay.
+template <uint16_t MaxJump, uint8_t MaxRejects = 3>
+class TFLunaOutlierGate {
+public:
+    void reset() {
+        _primed = false;
+        _rejects = 0;
+    }
+
+    uint16_t process(uint16_t value) {
+        uint16_t delta = value > _accepted ? value - _accepted : _accepted - value;
+        if (!_primed || delta <= MaxJump || _rejects >= MaxRejects) {
+            _accepted = value;
+            _primed = true;
+            _rejects = 0;
+        } else {
+            _rejects++;
+        }
+        return _accepted;
+    }
+
+    uint8_t getRejectCount() const {
+        return _rejects;
+    }
+
+private:
+    uint16_t _accepted = 0;
+    uint8_t _rejects = 0;
+    bool _primed = false;
+};
+
+// Compile-time chain of filter stages, applied first to last.
+//
+//     TFLunaFilterPipeline<TFLunaOutlierGate<50>,
+//                          TFLunaMedianFilter<5>,
+//                          TFLunaEMAFilter<64> > pipeline;
+//     uint16_t filtered = pipeline.process(raw);
+//
+// Each stage is a plain member, so the whole chain is inlined and its size is
+// exactly the sum of its stages.
+template <typename... Stages>
+class TFLunaFilterPipeline;
+
+// Resolves the type of stage Index in a pipeline and fetches it
+template <uint8_t Index, typename Pipeline>
+struct TFLunaPipelineStage;
+
+template <typename First, typename... Rest>
+struct TFLunaPipelineStage<0, TFLunaFilterPipeline<First, Rest...> > {
+    typedef First Type;
+
+    static Type& get(TFLunaFilterPipeline<First, Rest...>& pipeline) {
+        return pipeline.head();
+    }
+};
+
+template <uint8_t Index, typename First, typename... Rest>
+struct TFLunaPipelineStage<Index, TFLunaFilterPipeline<First, Rest...> > {
+    typedef TFLunaPipelineStage<Index - 1, TFLunaFilterPipeline<Rest...> > Next;
+    typedef typename Next::Type Type;
+
+    static Type& get(TFLunaFilterPipeline<First, Rest...>& pipeline) {
+        return Next::get(pipeline.tail());
+    }
+};
+
+template <>
+class TFLunaFilterPipeline<> {
+public:
+    uint16_t process(uint16_t value) {
+        return value;
+    }
+
+    void reset() {
+    }
+};
+
+template <typename First, typename... Rest>
+class TFLunaFilterPipeline<First, Rest...> {
+public:
+    uint16_t process(uint16_t value) {
+        return _rest.process(_first.process(value));
+    }
+
+    void reset() {
+        _first.reset();
+        _rest.reset();
+    }
+
+    First& head() {
+        return _first;
+    }
+
+    TFLunaFilterPipeline<Rest...>& tail() {
+        return _rest;
+    }
+
+    // Access to an individual stage, e.g. pipeline.stage<1>().setWindow(7)
+    template <uint8_t Index>
+    typename TFLunaPipelineStage<Index, TFLunaFilterPipeline>::Type& stage() {
+        return TFLunaPipelineStage<Index, TFLunaFilterPipeline>::get(*this);
+    }
+
+private:
+    First _first;
+    TFLunaFilterPipeline<Rest...> _rest;
+};
+
+#endif // TFLUNA_FILTERS_H
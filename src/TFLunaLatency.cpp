@@ -0,0 +1,109 @@
+#include "TFLunaLatency.h"
+
+#define TFLUNA_LATENCY_SUB_COUNT   (1 << TFLUNA_LATENCY_SUB_BITS)
+
+TFLunaLatencyHistogram::TFLunaLatencyHistogram() {
+    reset();
+}
+
+void TFLunaLatencyHistogram::record(uint32_t micros) {
+    uint8_t bucket = bucketOf(micros);
+    if (_buckets[bucket] == 0xFFFF) {
+        for (uint8_t i = 0; i < TFLUNA_LATENCY_BUCKETS; i++) {
+            _buckets[i] >>= 1;
+        }
+    }
+    _buckets[bucket]++;
+
+    _count++;
+    if (micros < _min) {
+        _min = micros;
+    }
+    if (micros > _max) {
+        _max = micros;
+    }
+}
+
+void TFLunaLatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _min = 0xFFFFFFFFUL;
+    _max = 0;
+}
+
+uint32_t TFLunaLatencyHistogram::getPercentile(uint8_t percent) const {
+    // Totals are recounted because halving changes them
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < TFLUNA_LATENCY_BUCKETS; i++) {
+        total += _buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the value, 1-based, rounded up
+    uint32_t rank = (total * (percent > 100 ? 100 : percent) + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    uint8_t bucket = 0;
+    while (bucket < TFLUNA_LATENCY_BUCKETS - 1) {
+        seen += _buckets[bucket];
+        if (seen >= rank) {
+            break;
+        }
+        bucket++;
+    }
+
+    uint32_t high = bucketHigh(bucket);
+    return high < _max ? high : _max;
+}
+
+uint32_t TFLunaLatencyHistogram::getCount() const {
+    return _count;
+}
+
+uint32_t TFLunaLatencyHistogram::getMin() const {
+    return _count > 0 ? _min : 0;
+}
+
+uint32_t TFLunaLatencyHistogram::getMax() const {
+    return _max;
+}
+
+uint16_t TFLunaLatencyHistogram::getBucketCount(uint8_t bucket) const {
+    return bucket < TFLUNA_LATENCY_BUCKETS ? _buckets[bucket] : 0;
+}
+
+uint8_t TFLunaLatencyHistogram::bucketOf(uint32_t micros) {
+    if (micros < TFLUNA_LATENCY_SUB_COUNT) {
+        return micros;
+    }
+    if (micros >> TFLUNA_LATENCY_MAX_BITS) {
+        return TFLUNA_LATENCY_BUCKETS - 1;
+    }
+
+    // Power of two from the leading bit, sub-bucket from the bits below it
+    uint8_t exponent = sizeof(unsigned long) * 8 - 1 - __builtin_clzl((unsigned long)micros);
+    uint8_t shift = exponent - TFLUNA_LATENCY_SUB_BITS;
+    uint8_t sub = (micros >> shift) & (TFLUNA_LATENCY_SUB_COUNT - 1);
+    return ((shift + 1) << TFLUNA_LATENCY_SUB_BITS) + sub;
+}
+
+uint32_t TFLunaLatencyHistogram::bucketLow(uint8_t bucket) {
+    if (bucket < TFLUNA_LATENCY_SUB_COUNT) {
+        return bucket;
+    }
+    uint8_t shift = (bucket >> TFLUNA_LATENCY_SUB_BITS) - 1;
+    uint8_t sub = bucket & (TFLUNA_LATENCY_SUB_COUNT - 1);
+    return (uint32_t)(TFLUNA_LATENCY_SUB_COUNT + sub) << shift;
+}
+
+uint32_t TFLunaLatencyHistogram::bucketHigh(uint8_t bucket) {
+    if (bucket >= TFLUNA_LATENCY_BUCKETS - 1) {
+        return 0xFFFFFFFFUL;
+    }
+    return bucketLow(bucket + 1) - 1;
+}
@@ -0,0 +1,51 @@
+#ifndef TFLUNA_LATENCY_H
+#define TFLUNA_LATENCY_H
+
+#include <Arduino.h>
+
+// Latency histograms inside TFLuna, off unless the library is built with
+// -DTFLUNA_LATENCY_HISTOGRAM=1 (e.g. PlatformIO build_flags). When off they
+// take no RAM and no time. The setting must be the same for every file.
+#ifndef TFLUNA_LATENCY_HISTOGRAM
+#define TFLUNA_LATENCY_HISTOGRAM 0
+#endif
+
+// Bucket layout: values below 2^SUB_BITS us get a bucket each, every power of
+// two above is split into 2^SUB_BITS buckets, so a bucket is at most 25% wide.
+// Values from 2^MAX_BITS us (about 1 s) on share the last bucket.
+#define TFLUNA_LATENCY_SUB_BITS    2
+#define TFLUNA_LATENCY_MAX_BITS    20
+#define TFLUNA_LATENCY_BUCKETS     ((TFLUNA_LATENCY_MAX_BITS - TFLUNA_LATENCY_SUB_BITS + 1) << TFLUNA_LATENCY_SUB_BITS)
+
+// Log-bucketed latency histogram in constant memory.
+//
+// record() is a bit scan and an increment. Counts are 16 bits; when one would
+// overflow all of them are halved, which keeps the percentiles and forgets
+// old history gradually. Percentiles are reported as the upper edge of the
+// bucket they fall in, never above the largest value recorded.
+class TFLunaLatencyHistogram {
+public:
+    TFLunaLatencyHistogram();
+
+    void record(uint32_t micros);
+    void reset();
+
+    uint32_t getPercentile(uint8_t percent) const;  // us, 0 when empty
+    uint32_t getCount() const;                      // Values recorded since reset
+    uint32_t getMin() const;
+    uint32_t getMax() const;
+
+    // Bucket access, e.g. for export
+    uint16_t getBucketCount(uint8_t bucket) const;
+    static uint8_t bucketOf(uint32_t micros);
+    static uint32_t bucketLow(uint8_t bucket);
+    static uint32_t bucketHigh(uint8_t bucket);
+
+private:
+    uint16_t _buckets[TFLUNA_LATENCY_BUCKETS];
+    uint32_t _count;
+    uint32_t _min;
+    uint32_t _max;
+};
+
+#endif // TFLUNA_LATENCY_H
@@ -0,0 +1,182 @@
+#include "TFLunaLogger.h"
+
+// Copy a string without its terminator, returns the end of the copy
+static char* appendText(char* out, const char* text) {
+    while (*text) {
+        *out++ = *text++;
+    }
+    return out;
+}
+
+// Unsigned decimal with at least minDigits digits
+static char* appendNumber(char* out, uint16_t value, uint8_t minDigits = 1) {
+    char digits[5];
+    uint8_t count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0 || count < minDigits);
+
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+void TFLunaLogger::begin(Print* output, uint8_t format) {
+    _output = output;
+    _format = format;
+    _reportsSpace = output != nullptr && output->availableForWrite() > 0;
+    _head = 0;
+    _count = 0;
+}
+
+void TFLunaLogger::end() {
+    flush(true);
+    _output = nullptr;
+}
+
+bool TFLunaLogger::isActive() const {
+    return _output != nullptr;
+}
+
+uint8_t TFLunaLogger::getFormat() const {
+    return _format;
+}
+
+bool TFLunaLogger::log(const TFLuna::Sample &sample, uint8_t errorCode) {
+    if (_output == nullptr) {
+        return false;
+    }
+
+    bool queued;
+    if (_format == TFLUNA_LOG_TEXT) {
+        char text[TFLUNA_LOG_TEXT_MAX];
+        uint8_t length = _formatText(text, sample, errorCode);
+        queued = _append((const uint8_t*)text, length);
+    } else {
+        // Sample is packed and every supported MCU is little-endian, so the
+        // struct is already in wire order
+        uint8_t record[TFLUNA_LOG_RECORD_LENGTH];
+        record[0] = TFLUNA_LOG_SYNC1;
+        record[1] = TFLUNA_LOG_SYNC2;
+        memcpy(&record[2], &sample, sizeof(TFLuna::Sample));
+        record[TFLUNA_LOG_RECORD_LENGTH - 2] = errorCode;
+
+        uint8_t checksum = 0;
+        for (uint8_t i = 0; i < TFLUNA_LOG_RECORD_LENGTH - 1; i++) {
+            checksum += record[i];
+        }
+        record[TFLUNA_LOG_RECORD_LENGTH - 1] = checksum;
+
+        queued = _append(record, TFLUNA_LOG_RECORD_LENGTH);
+    }
+
+    if (!queued) {
+        _dropped++;
+    }
+    return queued;
+}
+
+size_t TFLunaLogger::flush(bool blocking) {
+    if (_output == nullptr) {
+        return 0;
+    }
+
+    size_t written = 0;
+    while (_count > 0) {
+        // Oldest byte, then the contiguous run up to the end of the array
+        uint16_t tail = _head >= _count ? _head - _count : TFLUNA_LOG_BUFFER_SIZE + _head - _count;
+        uint16_t chunk = TFLUNA_LOG_BUFFER_SIZE - tail;
+        if (chunk > _count) {
+            chunk = _count;
+        }
+
+        if (!blocking) {
+            int space = _output->availableForWrite();
+            if (space > 0) {
+                _reportsSpace = true;
+            } else if (_reportsSpace) {
+                break;  // Transmit buffer full
+            } else {
+                // Output without availableForWrite(), write a bounded amount
+                space = TFLUNA_LOG_DIRECT_CHUNK - written;
+                if (space <= 0) {
+                    break;
+                }
+            }
+            if ((uint16_t)space < chunk) {
+                chunk = space;
+            }
+        }
+
+        size_t sent = _output->write(&_buffer[tail], chunk);
+        _count -= sent;
+        written += sent;
+        if (sent < chunk) {
+            break;  // Output refused the rest, keep it for the next call
+        }
+    }
+
+    return written;
+}
+
+uint16_t TFLunaLogger::getPending() const {
+    return _count;
+}
+
+uint32_t TFLunaLogger::getDroppedRecords() const {
+    return _dropped;
+}
+
+void TFLunaLogger::resetDroppedRecords() {
+    _dropped = 0;
+}
+
+bool TFLunaLogger::_append(const uint8_t* data, uint16_t length) {
+    if (length > TFLUNA_LOG_BUFFER_SIZE - _count) {
+        return false;
+    }
+
+    // At most two copies, before and after the wrap
+    uint16_t first = TFLUNA_LOG_BUFFER_SIZE - _head;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&_buffer[_head], data, first);
+    memcpy(&_buffer[0], data + first, length - first);
+
+    _head = (_head + length) % TFLUNA_LOG_BUFFER_SIZE;
+    _count += length;
+    return true;
+}
+
+uint8_t TFLunaLogger::_formatText(char* text, const TFLuna::Sample &sample, uint8_t errorCode) const {
+    char* out = text;
+
+    if (errorCode != TFLUNA_OK) {
+        out = appendText(out, "Error: ");
+        out = appendNumber(out, errorCode);
+    } else {
+        // Same line as the original per-field prints, without float formatting
+        int16_t temperature = sample.temperature;
+        uint16_t magnitude = temperature < 0 ? -(int32_t)temperature : temperature;
+
+        out = appendText(out, "Distance: ");
+        out = appendNumber(out, sample.distance);
+        out = appendText(out, sample.unit == TFLUNA_UNIT_MM ? " mm, Strength: " : " cm, Strength: ");
+        out = appendNumber(out, sample.strength);
+        out = appendText(out, ", Temp: ");
+        if (temperature < 0) {
+            *out++ = '-';
+        }
+        out = appendNumber(out, magnitude / 100);
+        *out++ = '.';
+        out = appendNumber(out, magnitude % 100, 2);
+        out = appendText(out, " \xC2\xB0" "C");
+    }
+    out = appendText(out, "\r\n");
+
+    return out - text;
+}
@@ -0,0 +1,71 @@
+#ifndef TFLUNA_LOGGER_H
+#define TFLUNA_LOGGER_H
+
+#include "TFLuna.h"
+
+// Log formats
+#define TFLUNA_LOG_BINARY          0
+#define TFLUNA_LOG_TEXT            1
+
+// RAM buffered between the sensor and the log output
+#define TFLUNA_LOG_BUFFER_SIZE     128
+
+// Binary record: sync, Sample, error code, checksum
+#define TFLUNA_LOG_SYNC1           0xA5
+#define TFLUNA_LOG_SYNC2           0x5A
+#define TFLUNA_LOG_RECORD_LENGTH   (2 + sizeof(TFLuna::Sample) + 2)
+
+// Longest text record, "Distance: 65535 cm, Strength: 65535, Temp: -327.68 °C\r\n"
+#define TFLUNA_LOG_TEXT_MAX        64
+
+// Most bytes one flush() writes to an output that does not report free space
+#define TFLUNA_LOG_DIRECT_CHUNK    TFLUNA_LOG_TEXT_MAX
+
+// Buffered sample logger.
+//
+// log() only copies a record into a RAM ring; flush() hands as much of it to
+// the output as the output can take without blocking (availableForWrite()).
+// A record that does not fit in the ring is dropped and counted, so logging
+// never stalls acquisition.
+//
+// Many Print classes (SoftwareSerial, SD File) keep the default
+// availableForWrite() of 0. An output that has never reported free space is
+// taken to be one of them and gets up to TFLUNA_LOG_DIRECT_CHUNK bytes per
+// flush(), written directly; that write may block as long as the output does.
+//
+// Binary records are TFLUNA_LOG_RECORD_LENGTH bytes, little-endian:
+//     0xA5 0x5A, the 17-byte Sample, error code, checksum
+// where the checksum is the low byte of the sum of all preceding bytes.
+// extras/tfluna_log2csv.py turns a captured log back into CSV.
+class TFLunaLogger {
+public:
+    void begin(Print* output, uint8_t format = TFLUNA_LOG_TEXT);
+    void end();                          // Writes what is left, blocking
+    bool isActive() const;
+    uint8_t getFormat() const;
+
+    // Queue one record, false when the buffer is full and it was dropped
+    bool log(const TFLuna::Sample &sample, uint8_t errorCode);
+
+    // Write buffered bytes; without blocking only what the output accepts now.
+    // Returns the number of bytes written.
+    size_t flush(bool blocking = false);
+
+    uint16_t getPending() const;         // Bytes waiting in the buffer
+    uint32_t getDroppedRecords() const;
+    void resetDroppedRecords();
+
+private:
+    bool _append(const uint8_t* data, uint16_t length);
+    uint8_t _formatText(char* text, const TFLuna::Sample &sample, uint8_t errorCode) const;
+
+    Print* _output = nullptr;
+    uint8_t _format = TFLUNA_LOG_TEXT;
+    bool _reportsSpace = false;          // availableForWrite() has been above 0
+    uint8_t _buffer[TFLUNA_LOG_BUFFER_SIZE];
+    uint16_t _head = 0;                  // Next byte to write
+    uint16_t _count = 0;                 // Bytes buffered
+    uint32_t _dropped = 0;
+};
+
+#endif // TFLUNA_LOGGER_H
@@ -0,0 +1,124 @@
+#ifndef TFLUNA_RING_BUFFER_H
+#define TFLUNA_RING_BUFFER_H
+
+#include "TFLuna.h"
+
+// Index type wide enough for Capacity + 1 slots. Single-byte indices keep the
+// ring lock-free on 8-bit MCUs, where 16-bit loads are not atomic.
+template <bool Small>
+struct TFLunaRingIndex {
+    typedef uint8_t type;
+};
+
+template <>
+struct TFLunaRingIndex<false> {
+    typedef uint16_t type;
+};
+
+// Fixed-capacity single-producer/single-consumer sample queue.
+//
+// The producer (an ISR, serialEvent() or a reader thread) calls push() or
+// fill(); the consumer (the main loop or another thread) calls pop() or
+// popBatch(). Each index is written by one side only and published with
+// release/acquire ordering, so no lock or interrupt masking is needed.
+// When the ring is full new samples are dropped and counted.
+template <uint16_t Capacity>
+class TFLunaSampleRing {
+public:
+    typedef typename TFLunaRingIndex<(Capacity < 255)>::type Index;
+
+#if defined(__AVR__)
+    static_assert(Capacity < 255, "Capacity must be below 255 to stay lock-free on AVR");
+#endif
+    static_assert(Capacity > 0, "Capacity must be at least 1");
+
+    // Producer side
+    bool push(const TFLuna::Sample &sample) {
+        Index head = _head;
+        Index next = _advance(head);
+        if (next == __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&_overflows, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+
+        _samples[head] = sample;
+        __atomic_store_n(&_head, next, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Run the sensor's non-blocking parser over the buffered bytes and queue
+    // every frame that completes. Returns the number of frames queued.
+    uint16_t fill(TFLuna &sensor) {
+        uint16_t count = 0;
+        TFLuna::Sample sample;
+
+        while (sensor.poll()) {
+            sensor.getSample(sample);
+            if (push(sample)) {
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+    // Consumer side
+    bool pop(TFLuna::Sample &sample) {
+        Index tail = _tail;
+        if (tail == __atomic_load_n(&_head, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+
+        sample = _samples[tail];
+        __atomic_store_n(&_tail, _advance(tail), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    uint16_t popBatch(TFLuna::Sample *samples, uint16_t maxSamples) {
+        Index tail = _tail;
+        Index head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        uint16_t count = 0;
+
+        // Copy everything published so far, then release the slots at once
+        while (tail != head && count < maxSamples) {
+            samples[count++] = _samples[tail];
+            tail = _advance(tail);
+        }
+
+        __atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // Either side. The result is a snapshot and may be stale immediately.
+    uint16_t size() const {
+        Index head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        Index tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        return head >= tail ? head - tail : Capacity + 1 - tail + head;
+    }
+
+    bool isEmpty() const {
+        return size() == 0;
+    }
+
+    uint16_t capacity() const {
+        return Capacity;
+    }
+
+    // Samples dropped because the consumer fell behind. Written by the
+    // producer only, safe to read from either side.
+    uint32_t getOverflowCount() const {
+        return __atomic_load_n(&_overflows, __ATOMIC_RELAXED);
+    }
+
+private:
+    static Index _advance(Index index) {
+        return index == Capacity ? 0 : index + 1;
+    }
+
+    TFLuna::Sample _samples[Capacity + 1];
+    Index _head = 0;         // Next slot to write, owned by the producer
+    Index _tail = 0;         // Next slot to read, owned by the consumer
+    uint32_t _overflows = 0; // Counted by the producer
+};
+
+#endif // TFLUNA_RING_BUFFER_H
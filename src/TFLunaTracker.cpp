@@ -0,0 +1,115 @@
+#include "TFLunaTracker.h"
+
+// Gains (alpha, beta in 1/256) by signal strength. Each pair satisfies the
+// steady-state Kalman relation beta = 2(2 - alpha) - 4 sqrt(1 - alpha) for a
+// measurement noise that shrinks as the return gets stronger.
+static const uint16_t TRACKER_STRENGTH_LIMITS[] = { 100, 300, 1000 };
+static const uint8_t TRACKER_ALPHA[] = { 51, 90, 128, 166 };
+static const uint8_t TRACKER_BETA[] = { 6, 19, 44, 85 };
+
+// 256 / steps, spreads the velocity correction over bridged frames
+static const uint8_t TRACKER_STEP_RECIPROCAL[] = { 0, 128, 85, 64, 51, 43, 37, 32 };
+
+TFLunaTracker::TFLunaTracker(uint16_t frameRate) {
+    setFrameRate(frameRate);
+}
+
+void TFLunaTracker::setFrameRate(uint16_t frameRate) {
+    if (frameRate < 1) {
+        frameRate = 1;
+    } else if (frameRate > TFLUNA_TRACKER_MAX_RATE) {
+        frameRate = TFLUNA_TRACKER_MAX_RATE;
+    }
+    
+    _frameRate = frameRate;
+    _periodQ16 = 65536UL / frameRate; // Only divide, done once per configuration
+    reset();
+}
+
+void TFLunaTracker::reset() {
+    _position = 0;
+    _velocity = 0;
+    _tracking = false;
+}
+
+uint16_t TFLunaTracker::update(uint16_t distance, uint16_t strength, uint8_t steps) {
+    int32_t measured = (int32_t)distance << 8;
+    
+    // Predict across the elapsed frames
+    if (steps < 1) {
+        steps = 1;
+    }
+    int32_t predicted = _position + ((_velocity * (int32_t)_periodQ16 + 2048) >> 12) * steps;
+    int32_t residual = measured - predicted;
+    int32_t residualQ4 = (residual + 8) >> 4;
+    
+    // Start a new track after a long gap or when a different object appears;
+    // the bound also keeps every product below within 32 bits
+    if (!_tracking || steps > TFLUNA_TRACKER_MAX_GAP ||
+        residualQ4 > TFLUNA_TRACKER_MAX_RESIDUAL || residualQ4 < -TFLUNA_TRACKER_MAX_RESIDUAL) {
+        _position = measured;
+        _velocity = 0;
+        _tracking = true;
+        return distance;
+    }
+    
+    // Pick gains from the signal strength; 0xFFFF flags an overexposed return
+    uint8_t level = 0;
+    while (level < 3 && strength != 0xFFFF && strength >= TRACKER_STRENGTH_LIMITS[level]) {
+        level++;
+    }
+    
+    // Correct with the residual, rounding to nearest
+    int32_t correction = (residualQ4 * TRACKER_BETA[level] * _frameRate + 128) >> 8;
+    if (steps > 1) {
+        correction = (correction * TRACKER_STEP_RECIPROCAL[steps - 1] + 128) >> 8;
+    }
+    _position = predicted + ((residual * TRACKER_ALPHA[level] + 128) >> 8);
+    _velocity += correction;
+    
+    const int32_t maxVelocity = (int32_t)TFLUNA_TRACKER_MAX_VELOCITY << 4;
+    if (_velocity > maxVelocity) {
+        _velocity = maxVelocity;
+    } else if (_velocity < -maxVelocity) {
+        _velocity = -maxVelocity;
+    }
+    if (_position < 0) {
+        _position = 0;
+    }
+    
+    return getDistance();
+}
+
+uint16_t TFLunaTracker::update(const TFLuna::Sample &sample) {
+    uint32_t gap = sample.sequence - _lastSequence;
+    _lastSequence = sample.sequence;
+    
+    uint8_t steps = gap > TFLUNA_TRACKER_MAX_GAP ? TFLUNA_TRACKER_MAX_GAP + 1 : (uint8_t)gap;
+    uint16_t distance = sample.distance;
+    if (sample.unit == TFLUNA_UNIT_MM) {
+        distance = (distance + 5) / 10;
+    }
+    return update(distance, sample.strength, steps);
+}
+
+// Tracked state
+uint16_t TFLunaTracker::getDistance() const {
+    int32_t rounded = (_position + 128) >> 8;
+    return rounded > 0xFFFF ? 0xFFFF : (uint16_t)rounded;
+}
+
+int32_t TFLunaTracker::getDistanceQ4() const {
+    return (_position + 8) >> 4;
+}
+
+int16_t TFLunaTracker::getVelocity() const {
+    return (int16_t)((_velocity + 8) >> 4);
+}
+
+int32_t TFLunaTracker::getVelocityQ4() const {
+    return _velocity;
+}
+
+bool TFLunaTracker::isTracking() const {
+    return _tracking;
+}
@@ -0,0 +1,54 @@
+#ifndef TFLUNA_TRACKER_H
+#define TFLUNA_TRACKER_H
+
+#include "TFLuna.h"
+
+// Velocity limit of the tracker, keeps the fixed-point products in 32 bits
+#define TFLUNA_TRACKER_MAX_VELOCITY   2000   // cm/s
+
+// Longest gap (in frames) bridged by prediction before the track restarts
+#define TFLUNA_TRACKER_MAX_GAP        8
+
+// Residual (1/16 cm) beyond which the target is treated as a new object
+#define TFLUNA_TRACKER_MAX_RESIDUAL   32767
+
+// Highest frame rate of the sensor
+#define TFLUNA_TRACKER_MAX_RATE       250
+
+// Constant-velocity alpha-beta tracker in integer arithmetic.
+//
+// Distance is tracked in 1/256 cm and velocity in 1/16 cm/s. The sample period
+// comes from the configured frame rate, so an update is a fixed sequence of
+// multiplies and shifts with no divide and no loop. The gains are the
+// steady-state Kalman gains for a measurement noise that falls with signal
+// strength: weak returns move the estimate less than strong ones.
+class TFLunaTracker {
+public:
+    TFLunaTracker(uint16_t frameRate = 100);
+
+    void setFrameRate(uint16_t frameRate);
+    void reset();
+
+    // Feed one measurement; steps > 1 predicts across frames that were lost.
+    // Returns the tracked distance in cm.
+    uint16_t update(uint16_t distance, uint16_t strength, uint8_t steps = 1);
+    // Steps from the sequence number; millimetre samples are tracked in cm
+    uint16_t update(const TFLuna::Sample &sample);
+
+    // Tracked state
+    uint16_t getDistance() const;      // cm, rounded
+    int32_t getDistanceQ4() const;     // 1/16 cm
+    int16_t getVelocity() const;       // cm/s, positive when moving away
+    int32_t getVelocityQ4() const;     // 1/16 cm/s
+    bool isTracking() const;
+
+private:
+    int32_t _position = 0;             // 1/256 cm
+    int32_t _velocity = 0;             // 1/16 cm/s
+    uint16_t _frameRate = 100;         // 1 / sample period
+    uint32_t _periodQ16 = 655;         // Sample period in 1/65536 s
+    uint32_t _lastSequence = 0;
+    bool _tracking = false;
+};
+
+#endif // TFLUNA_TRACKER_H
@@ -0,0 +1,711 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <TFLuna.h>
+#include <TFLunaAdvanced.h>
+#include <TFLunaFilters.h>
+#include <TFLunaLogger.h>
+#include <TFLunaCapture.h>
+#include <TFLunaTracker.h>
+#include <TFLunaArray.h>
+
+#ifdef TFLUNA_HOST_BUILD
+#include <thread>
+#endif
+
+// Throughput benchmarks. Timings are printed for comparison between builds;
+// the assertions only check that every path decoded the same data.
+
+#define BENCH_FRAMES 100
+#define BENCH_ROUNDS 20
+#define BENCH_FILTER_SAMPLES 2000
+#define BENCH_PARALLEL_READS 200
+
+// Each result is timed over whole passes until this much time has passed.
+// On the host shorter totals are mostly timer and scheduling jitter; boards
+// keep a single pass, the default sizes already take long enough there.
+#ifndef BENCH_MIN_MICROS
+#ifdef TFLUNA_HOST_BUILD
+#define BENCH_MIN_MICROS 10000UL
+#else
+#define BENCH_MIN_MICROS 0
+#endif
+#endif
+
+// Replays of the recorded frames; raise on the host for captures of millions
+// of frames, e.g. -DBENCH_REPLAY_ROUNDS=10000
+#ifndef BENCH_REPLAY_ROUNDS
+#define BENCH_REPLAY_ROUNDS BENCH_ROUNDS
+#endif
+
+// Mock stream serving a fixed buffer, large enough for a burst of frames
+class BenchStream : public Stream {
+public:
+    void setData(const uint8_t* data, size_t length) {
+        _data = data;
+        _length = length;
+        _readIndex = 0;
+    }
+    
+    int available() override {
+        return _length - _readIndex;
+    }
+    
+    int read() override {
+        if (_readIndex < _length) {
+            return _data[_readIndex++];
+        }
+        return -1;
+    }
+    
+    int peek() override {
+        if (_readIndex < _length) {
+            return _data[_readIndex];
+        }
+        return -1;
+    }
+    
+    size_t write(uint8_t data) override {
+        return 1;
+    }
+    
+private:
+    const uint8_t* _data = NULL;
+    size_t _length = 0;
+    size_t _readIndex = 0;
+};
+
+// Log sink that accepts everything and counts the bytes
+class CountingPrint : public Print {
+public:
+    int availableForWrite() override {
+        return 4096;
+    }
+    
+    size_t write(uint8_t data) override {
+        bytes++;
+        return 1;
+    }
+    
+    size_t write(const uint8_t* buffer, size_t size) override {
+        bytes += size;
+        return size;
+    }
+    
+    uint32_t bytes = 0;
+};
+
+// Capture output into a fixed buffer
+class CaptureBuffer : public Print {
+public:
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+    
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (length + size > sizeof(data)) {
+            return 0;
+        }
+        memcpy(&data[length], buffer, size);
+        length += size;
+        return size;
+    }
+    
+    uint8_t data[BENCH_FRAMES * TFLUNA_FRAME_LENGTH * 3 / 2];
+    size_t length = 0;
+};
+
+#ifdef TFLUNA_HOST_BUILD
+// TF-Luna register map on the host I2C bus: a write sets the register pointer
+// and stores any data after it, a read returns consecutive registers
+class BenchI2CDevice : public HostI2CDevice {
+public:
+    BenchI2CDevice() {
+        memset(registers, 0, sizeof(registers));
+        registers[TFLUNA_I2C_DIST_L] = 150;
+        registers[TFLUNA_I2C_STRENGTH_L] = 0xE8;
+        registers[TFLUNA_I2C_STRENGTH_H] = 0x03;
+        registers[TFLUNA_I2C_FRAME_RATE] = 100;
+    }
+    
+    bool onWrite(const uint8_t* data, size_t length) override {
+        if (length > 0) {
+            _pointer = data[0];
+        }
+        for (size_t i = 1; i < length; i++) {
+            registers[(uint8_t)(_pointer + i - 1)] = data[i];
+        }
+        return true;
+    }
+    
+    size_t onRead(uint8_t* data, size_t length) override {
+        for (size_t i = 0; i < length; i++) {
+            data[i] = registers[(uint8_t)(_pointer + i)];
+        }
+        registers[TFLUNA_I2C_TICK_L]++;  // Each read sees a new measurement
+        return length;
+    }
+    
+    uint8_t registers[256];
+    
+private:
+    uint8_t _pointer = 0;
+};
+#endif
+
+BenchStream benchStream;
+uint8_t frameData[BENCH_FRAMES * TFLUNA_FRAME_LENGTH];
+
+void buildFrames() {
+    for (uint16_t i = 0; i < BENCH_FRAMES; i++) {
+        uint8_t* frame = &frameData[i * TFLUNA_FRAME_LENGTH];
+        uint16_t distance = 20 + (i * 7) % 780;
+        frame[0] = TFLUNA_FRAME_HEADER;
+        frame[1] = TFLUNA_FRAME_HEADER;
+        frame[2] = distance & 0xFF;
+        frame[3] = distance >> 8;
+        frame[4] = 0xE8;
+        frame[5] = 0x03;
+        frame[6] = 0x2C;
+        frame[7] = 0x01;
+        frame[8] = 0;
+        for (uint8_t j = 0; j < TFLUNA_FRAME_LENGTH - 1; j++) {
+            frame[8] += frame[j];
+        }
+    }
+}
+
+uint16_t filterInput[BENCH_FILTER_SAMPLES];
+
+void buildFilterInput() {
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+        seed = seed * 1103515245UL + 12345UL;
+        filterInput[i] = 200 + (seed >> 16) % 64;
+    }
+}
+
+void reportTiming(const char* name, uint32_t elapsedMicros, uint32_t items) {
+    Serial.print(name);
+    Serial.print(": ");
+    Serial.print(elapsedMicros);
+    Serial.print(" us total, ");
+    Serial.print((float)elapsedMicros / items, 3);
+    Serial.print(" us/item");
+#ifdef F_CPU
+    Serial.print(", ");
+    Serial.print((uint32_t)((uint64_t)elapsedMicros * (F_CPU / 1000000UL) / items));
+    Serial.print(" cycles/item");
+#endif
+    Serial.println();
+}
+
+// Run pass until BENCH_MIN_MICROS have elapsed, at least once. Returns the
+// number of passes and sets elapsed to their total time.
+template <typename Pass>
+uint32_t benchPasses(Pass pass, uint32_t &elapsed) {
+    uint32_t passes = 0;
+    uint32_t start = micros();
+    do {
+        pass();
+        passes++;
+        elapsed = micros() - start;
+    } while (elapsed < BENCH_MIN_MICROS);
+    return passes;
+}
+
+// Median as computed before the streaming filter: copy the window and
+// bubble-sort it on every sample
+uint16_t referenceMedian(const uint16_t* buffer, uint8_t bufferSize, uint8_t bufferIndex,
+                         uint8_t windowSize) {
+    uint16_t tempArray[15];
+    for (uint8_t i = 0; i < windowSize; i++) {
+        uint8_t idx = (bufferIndex - 1 - i + bufferSize) % bufferSize;
+        tempArray[i] = buffer[idx];
+    }
+    for (uint8_t i = 0; i < windowSize - 1; i++) {
+        for (uint8_t j = 0; j < windowSize - i - 1; j++) {
+            if (tempArray[j] > tempArray[j + 1]) {
+                uint16_t temp = tempArray[j];
+                tempArray[j] = tempArray[j + 1];
+                tempArray[j + 1] = temp;
+            }
+        }
+    }
+    return tempArray[windowSize / 2];
+}
+
+void bench_uart_per_byte_parser() {
+    TFLuna sensor(&benchStream);
+    uint32_t frames = 0;
+    uint32_t elapsed;
+    
+    uint32_t passes = benchPasses([&]() {
+        for (uint8_t round = 0; round < BENCH_ROUNDS; round++) {
+            benchStream.setData(frameData, sizeof(frameData));
+            while (sensor.poll()) {
+                frames++;
+            }
+        }
+    }, elapsed);
+    
+    reportTiming("UART poll()", elapsed, frames);
+    TEST_ASSERT_EQUAL((uint32_t)BENCH_FRAMES * BENCH_ROUNDS * passes, frames);
+}
+
+void bench_uart_batch_decode() {
+    TFLuna sensor(&benchStream);
+    TFLuna::Sample samples[BENCH_FRAMES];
+    uint32_t frames = 0;
+    size_t consumed, dropped;
+    uint32_t elapsed;
+    
+    uint32_t passes = benchPasses([&]() {
+        for (uint8_t round = 0; round < BENCH_ROUNDS; round++) {
+            frames += sensor.decodeFrames(frameData, sizeof(frameData), samples, BENCH_FRAMES,
+                                          consumed, dropped);
+        }
+    }, elapsed);
+    
+    reportTiming("UART decodeFrames()", elapsed, frames);
+    TEST_ASSERT_EQUAL((uint32_t)BENCH_FRAMES * BENCH_ROUNDS * passes, frames);
+    TEST_ASSERT_EQUAL(0, dropped);
+    TEST_ASSERT_EQUAL(20 + ((BENCH_FRAMES - 1) * 7) % 780, samples[BENCH_FRAMES - 1].distance);
+}
+
+#ifdef TFLUNA_HOST_BUILD
+void bench_i2c_reads() {
+    // Library overhead only: the mock bus transfers without wire time
+    BenchI2CDevice device;
+    Wire.attach(TFLUNA_DEFAULT_I2C_ADDR, &device);
+    Wire.simulateTiming(false);
+    TFLuna sensor(&Wire);
+    uint32_t checksum = 0;
+    const uint32_t reads = (uint32_t)BENCH_FRAMES * BENCH_ROUNDS;
+    uint32_t elapsed;
+    
+    uint32_t passes = benchPasses([&]() {
+        for (uint32_t i = 0; i < reads; i++) {
+            if (sensor.getDataI2C()) {
+                checksum += sensor.getDistance();
+            }
+        }
+    }, elapsed);
+    reportTiming("I2C getDataI2C()", elapsed, reads * passes);
+    TEST_ASSERT_EQUAL(150 * reads * passes, checksum);
+    
+    uint16_t frameRate = 0;
+    passes = benchPasses([&]() {
+        for (uint32_t i = 0; i < reads; i++) {
+            sensor.getFrameRate(frameRate);
+        }
+    }, elapsed);
+    reportTiming("I2C getFrameRate() from the bus", elapsed, reads * passes);
+    
+    TEST_ASSERT_TRUE(sensor.refreshRegisterCache());
+    passes = benchPasses([&]() {
+        for (uint32_t i = 0; i < reads; i++) {
+            sensor.getFrameRate(frameRate);
+        }
+    }, elapsed);
+    reportTiming("I2C getFrameRate() from the cache", elapsed, reads * passes);
+    TEST_ASSERT_EQUAL(100, frameRate);
+    
+    Wire.simulateTiming(true);
+    Wire.detach(TFLUNA_DEFAULT_I2C_ADDR);
+}
+
+// Read BENCH_PARALLEL_READS samples on each array, one thread per bus
+uint32_t timeParallelReads(TFLunaArray** arrays, uint8_t buses) {
+    std::thread threads[2];
+    uint32_t start = micros();
+    
+    for (uint8_t bus = 0; bus < buses; bus++) {
+        TFLunaArray* array = arrays[bus];
+        threads[bus] = std::thread([array]() {
+            for (uint16_t i = 0; i < BENCH_PARALLEL_READS; i++) {
+                array->update();
+            }
+        });
+    }
+    for (uint8_t bus = 0; bus < buses; bus++) {
+        threads[bus].join();
+    }
+    
+    return micros() - start;
+}
+
+void bench_parallel_buses() {
+    // Host version of test_hardware_parallel_buses: the mock buses take the
+    // wire time of each transfer at 400 kHz, the controllers independently
+    BenchI2CDevice devices[2];
+    Wire.attach(TFLUNA_DEFAULT_I2C_ADDR, &devices[0]);
+    Wire1.attach(TFLUNA_DEFAULT_I2C_ADDR, &devices[1]);
+    Wire.simulateTiming(true);
+    Wire1.simulateTiming(true);
+    
+    TFLunaArray first(&Wire);
+    TFLunaArray second(&Wire1);
+    TFLunaArray* arrays[2] = {&first, &second};
+    first.addSensor(TFLUNA_DEFAULT_I2C_ADDR);
+    second.addSensor(TFLUNA_DEFAULT_I2C_ADDR);
+    TEST_ASSERT_TRUE(first.begin());
+    TEST_ASSERT_TRUE(second.begin());
+    Wire.setClock(400000);
+    Wire1.setClock(400000);
+    
+    // Best of three, the sleeps standing in for wire time overshoot at random
+    uint32_t oneBus = UINT32_MAX;
+    uint32_t twoBuses = UINT32_MAX;
+    for (uint8_t run = 0; run < 3; run++) {
+        uint32_t elapsed = timeParallelReads(arrays, 1);
+        if (elapsed < oneBus) {
+            oneBus = elapsed;
+        }
+        elapsed = timeParallelReads(arrays, 2);
+        if (elapsed < twoBuses) {
+            twoBuses = elapsed;
+        }
+    }
+    uint32_t speedupPercent = 2UL * oneBus * 100 / twoBuses;   // 200 is linear
+    reportTiming("I2C array, one bus", oneBus, BENCH_PARALLEL_READS);
+    reportTiming("I2C array, two buses", twoBuses, 2 * BENCH_PARALLEL_READS);
+    Serial.print("Two-bus speedup: ");
+    Serial.print(speedupPercent / 100.0);
+    Serial.println("x");
+    
+    TEST_ASSERT_EQUAL(TFLUNA_OK, first.getErrorCode(0));
+    TEST_ASSERT_EQUAL(TFLUNA_OK, second.getErrorCode(0));
+    TEST_ASSERT_EQUAL(150, second.getSample(0).distance);
+    TEST_ASSERT_GREATER_OR_EQUAL(140, speedupPercent);
+    
+    Wire.detach(TFLUNA_DEFAULT_I2C_ADDR);
+    Wire1.detach(TFLUNA_DEFAULT_I2C_ADDR);
+    Wire.setClock(100000);
+    Wire1.setClock(100000);
+}
+#endif
+
+void bench_capture_replay() {
+    static CaptureBuffer capture;
+    
+    // Record one pass over the frames as the parser reads them, the last
+    // recording is kept
+    TFLunaRecorder recorder(&benchStream);
+    TFLuna recording(&recorder);
+    bool started = true;
+    uint32_t elapsed;
+    uint32_t passes = benchPasses([&]() {
+        capture.length = 0;
+        started = recorder.begin(&capture) && started;
+        benchStream.setData(frameData, sizeof(frameData));
+        while (recording.poll()) {
+        }
+        recorder.end();
+    }, elapsed);
+    reportTiming("Recorded poll()", elapsed, BENCH_FRAMES * passes);
+    TEST_ASSERT_TRUE(started);
+    TEST_ASSERT_EQUAL(0, recorder.getDroppedBytes());
+    Serial.print("Capture bytes per frame: ");
+    Serial.println((float)capture.length / BENCH_FRAMES, 2);
+    
+    // Parser throughput on the capture, replayed as fast as possible
+    TFLunaReplayStream replay;
+    TFLuna sensor(&replay);
+    uint32_t frames = 0;
+    passes = benchPasses([&]() {
+        for (uint32_t round = 0; round < BENCH_REPLAY_ROUNDS; round++) {
+            replay.begin(capture.data, capture.length);
+            while (sensor.poll()) {
+                frames++;
+            }
+        }
+    }, elapsed);
+    reportTiming("Replayed poll()", elapsed, frames);
+    TEST_ASSERT_EQUAL((uint32_t)BENCH_FRAMES * BENCH_REPLAY_ROUNDS * passes, frames);
+}
+
+void bench_median_filter() {
+    char name[40];
+    
+    for (uint8_t window = 3; window <= 15; window += 2) {
+        uint16_t buffer[15];
+        uint8_t bufferIndex = 0;
+        uint32_t checksumReference = 0;
+        uint32_t checksumStreaming = 0;
+        uint32_t elapsedReference, elapsedStreaming;
+        
+        // Sort-per-sample reference, window pre-filled like a running filter.
+        // Every pass starts over, so the checksums are those of the last pass.
+        uint32_t passesReference = benchPasses([&]() {
+            for (uint8_t i = 0; i < window; i++) {
+                buffer[i] = filterInput[i];
+            }
+            bufferIndex = 0;
+            checksumReference = 0;
+            for (uint16_t i = window; i < BENCH_FILTER_SAMPLES; i++) {
+                buffer[bufferIndex] = filterInput[i];
+                bufferIndex = (bufferIndex + 1) % window;
+                checksumReference += referenceMedian(buffer, window, bufferIndex, window);
+            }
+        }, elapsedReference);
+        
+        TFLunaMedianFilter<15> median;
+        uint32_t passesStreaming = benchPasses([&]() {
+            median.setWindow(window);
+            for (uint8_t i = 0; i < window; i++) {
+                median.process(filterInput[i]);
+            }
+            checksumStreaming = 0;
+            for (uint16_t i = window; i < BENCH_FILTER_SAMPLES; i++) {
+                checksumStreaming += median.process(filterInput[i]);
+            }
+        }, elapsedStreaming);
+        
+        snprintf(name, sizeof(name), "Median %u bubble sort", window);
+        reportTiming(name, elapsedReference, (BENCH_FILTER_SAMPLES - window) * passesReference);
+        snprintf(name, sizeof(name), "Median %u streaming", window);
+        reportTiming(name, elapsedStreaming, (BENCH_FILTER_SAMPLES - window) * passesStreaming);
+        TEST_ASSERT_EQUAL(checksumReference, checksumStreaming);
+    }
+}
+
+void bench_filter_chain() {
+    TFLunaMedianFilter<15> median;
+    TFLunaMeanFilter<20> mean;
+    uint32_t checksum = 0;
+    
+    uint32_t elapsed;
+    
+    median.setWindow(5);
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            checksum += median.process(filterInput[i]);
+        }
+    }, elapsed);
+    reportTiming("Median 5 alone", elapsed, BENCH_FILTER_SAMPLES * passes);
+    
+    mean.setWindow(5);
+    passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            checksum += mean.process(filterInput[i]);
+        }
+    }, elapsed);
+    reportTiming("Mean 5 alone", elapsed, BENCH_FILTER_SAMPLES * passes);
+    
+    median.setWindow(5);
+    mean.setWindow(5);
+    passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            checksum += mean.process(median.process(filterInput[i]));
+        }
+    }, elapsed);
+    reportTiming("Median 5 -> mean 5", elapsed, BENCH_FILTER_SAMPLES * passes);
+    
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+}
+
+template <typename Pipeline>
+void benchPipeline(const char* name) {
+    Pipeline pipeline;
+    uint32_t checksum = 0;
+    uint32_t elapsed;
+    
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            checksum += pipeline.process(filterInput[i]);
+        }
+    }, elapsed);
+    
+    Serial.print(name);
+    Serial.print(" RAM: ");
+    Serial.print((uint32_t)sizeof(Pipeline));
+    Serial.print(" bytes, ");
+    reportTiming("time", elapsed, BENCH_FILTER_SAMPLES * passes);
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+}
+
+void bench_filter_pipelines() {
+    // Each filter on its own
+    benchPipeline<TFLunaFilterPipeline<TFLunaMeanFilter<4> > >("Mean<4>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaEMAFilter<64> > >("EMA<64>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaDeadbandFilter<1> > >("Deadband<1>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaOutlierGate<50> > >("OutlierGate<50>");
+    
+    benchPipeline<TFLunaAdvanced::Filters>("TFLunaAdvanced::Filters");
+    benchPipeline<TFLunaFilterPipeline<TFLunaMedianFilter<5> > >("Median<5>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaMedianFilter<5>, TFLunaMeanFilter<4> > >(
+        "Median<5> -> Mean<4>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaOutlierGate<50>, TFLunaEMAFilter<64> > >(
+        "OutlierGate<50> -> EMA<64>");
+    benchPipeline<TFLunaFilterPipeline<TFLunaOutlierGate<50>, TFLunaMedianFilter<3>,
+                                       TFLunaEMAFilter<64>, TFLunaDeadbandFilter<1> > >(
+        "OutlierGate -> Median<3> -> EMA<64> -> Deadband<1>");
+}
+
+void bench_tracker() {
+    TFLunaTracker tracker;
+    uint32_t checksum = 0;
+    
+    uint32_t elapsed;
+    
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            checksum += tracker.update(filterInput[i], 1000);
+        }
+    }, elapsed);
+    reportTiming("Tracker update()", elapsed, BENCH_FILTER_SAMPLES * passes);
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+}
+
+void bench_unit_conversions() {
+    TFLuna::Sample samples[BENCH_FRAMES];
+    uint32_t meters[BENCH_FRAMES];
+    int32_t fahrenheit[BENCH_FRAMES];
+    uint8_t quality[BENCH_FRAMES];
+    float checksumFloat = 0;
+    uint32_t checksumFixed = 0;
+    
+    for (uint16_t i = 0; i < BENCH_FRAMES; i++) {
+        samples[i].distance = filterInput[i];
+        samples[i].strength = 20 + (i * 37) % 2100;
+        samples[i].temperature = -1000 + i * 61;
+    }
+    
+    // Float conversions as done by the original getters
+    uint32_t elapsed;
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t round = 0; round < BENCH_ROUNDS; round++) {
+            for (uint16_t i = 0; i < BENCH_FRAMES; i++) {
+                checksumFloat += samples[i].distance / 100.0f;
+                checksumFloat += (samples[i].temperature / 100.0f) * 9.0f / 5.0f + 32.0f;
+                checksumFloat += (float)(uint8_t)((uint32_t)(samples[i].strength - 30) * 100 / 1970);
+            }
+        }
+    }, elapsed);
+    reportTiming("Float conversions", elapsed, BENCH_FRAMES * BENCH_ROUNDS * passes);
+    
+    passes = benchPasses([&]() {
+        for (uint16_t round = 0; round < BENCH_ROUNDS; round++) {
+            TFLunaAdvanced::toMetersQ16(samples, meters, BENCH_FRAMES);
+            TFLunaAdvanced::toCentiFahrenheit(samples, fahrenheit, BENCH_FRAMES);
+            TFLunaAdvanced::toSignalQuality(samples, quality, BENCH_FRAMES);
+            checksumFixed += meters[round] + fahrenheit[round] + quality[round];
+        }
+    }, elapsed);
+    reportTiming("Fixed-point batch conversions", elapsed, BENCH_FRAMES * BENCH_ROUNDS * passes);
+    
+    TEST_ASSERT_NOT_EQUAL(0, checksumFixed);
+    TEST_ASSERT_TRUE(checksumFloat != 0);
+}
+
+void bench_latency_histogram() {
+    TFLunaLatencyHistogram histogram;
+    uint32_t checksum = 0;
+    
+    // Latencies spread over several powers of two
+    uint32_t elapsed;
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t round = 0; round < BENCH_ROUNDS; round++) {
+            for (uint16_t i = 0; i < BENCH_FRAMES; i++) {
+                histogram.record(filterInput[i] * (round + 1));
+            }
+        }
+    }, elapsed);
+    reportTiming("Latency histogram record", elapsed, BENCH_FRAMES * BENCH_ROUNDS * passes);
+    
+    passes = benchPasses([&]() {
+        for (uint16_t round = 0; round < BENCH_ROUNDS; round++) {
+            checksum += histogram.getPercentile(99);
+        }
+    }, elapsed);
+    reportTiming("Latency histogram p99", elapsed, BENCH_ROUNDS * passes);
+    
+    Serial.print("Histogram RAM: ");
+    Serial.print(sizeof(histogram));
+    Serial.println(" bytes");
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+}
+
+void bench_logging() {
+    CountingPrint sink;
+    TFLunaLogger logger;
+    TFLuna::Sample sample = {0, 1000, 2512, 0, 0, 0, TFLUNA_UNIT_CM};
+    
+    // Per-field prints as done before the logger, including float formatting
+    uint32_t elapsed;
+    uint32_t passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            sample.distance = filterInput[i];
+            sink.print("Distance: ");
+            sink.print(sample.distance);
+            sink.print(" cm, Strength: ");
+            sink.print(sample.strength);
+            sink.print(", Temp: ");
+            sink.print(sample.temperature / 100.0);
+            sink.println(" °C");
+        }
+    }, elapsed);
+    reportTiming("Per-field text prints", elapsed, BENCH_FILTER_SAMPLES * passes);
+    uint32_t textBytes = sink.bytes / passes;   // Per pass
+    
+    sink.bytes = 0;
+    logger.begin(&sink, TFLUNA_LOG_TEXT);
+    passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            sample.distance = filterInput[i];
+            logger.log(sample, TFLUNA_OK);
+            logger.flush();
+        }
+    }, elapsed);
+    reportTiming("Buffered text log", elapsed, BENCH_FILTER_SAMPLES * passes);
+    TEST_ASSERT_EQUAL(textBytes * passes, sink.bytes);
+    
+    sink.bytes = 0;
+    logger.begin(&sink, TFLUNA_LOG_BINARY);
+    passes = benchPasses([&]() {
+        for (uint16_t i = 0; i < BENCH_FILTER_SAMPLES; i++) {
+            sample.distance = filterInput[i];
+            sample.sequence = i;
+            logger.log(sample, TFLUNA_OK);
+            logger.flush();
+        }
+    }, elapsed);
+    reportTiming("Buffered binary log", elapsed, BENCH_FILTER_SAMPLES * passes);
+    
+    Serial.print("Bytes per sample, text: ");
+    Serial.print(textBytes / BENCH_FILTER_SAMPLES);
+    Serial.print(", binary: ");
+    Serial.println(sink.bytes / passes / BENCH_FILTER_SAMPLES);
+    TEST_ASSERT_EQUAL((uint32_t)BENCH_FILTER_SAMPLES * TFLUNA_LOG_RECORD_LENGTH * passes, sink.bytes);
+    TEST_ASSERT_EQUAL(0, logger.getDroppedRecords());
+}
+
+void setup() {
+    delay(2000);  // Give the serial monitor time to open
+    Serial.begin(115200);
+    buildFrames();
+    buildFilterInput();
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(bench_uart_per_byte_parser);
+    RUN_TEST(bench_uart_batch_decode);
+    RUN_TEST(bench_capture_replay);
+#ifdef TFLUNA_HOST_BUILD
+    RUN_TEST(bench_i2c_reads);
+    RUN_TEST(bench_parallel_buses);
+#endif
+    RUN_TEST(bench_median_filter);
+    RUN_TEST(bench_filter_chain);
+    RUN_TEST(bench_filter_pipelines);
+    RUN_TEST(bench_tracker);
+    RUN_TEST(bench_unit_conversions);
+    RUN_TEST(bench_latency_histogram);
+    RUN_TEST(bench_logging);
+    
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
@@ -12,4 +12,8 @@
 // I2C address for hardware tests (if enabled)
 #define HARDWARE_I2C_ADDR 0x10
 
+// Second I2C controller for the parallel bus benchmark, with one sensor at
+// HARDWARE_I2C_ADDR on each bus
+#define HARDWARE_WIRE_2 Wire1
+
 #endif // TEST_CONFIG_H
@@ -3,6 +3,13 @@
 #include "test_config.h"
 #include <TFLuna.h>
 #include <TFLunaAdvanced.h>
+#include <TFLunaArray.h>
+
+// Parallel reads need a core per bus and thread support
+#if defined(ESP32)
+#include <thread>
+#define HARDWARE_PARALLEL_BUSES
+#endif
 
 #ifdef ENABLE_HARDWARE_TESTS
 // Hardware test variables
@@ -36,15 +43,26 @@ void test_hardware_uart_data() {
     TEST_ASSERT_GREATER_OR_EQUAL(0, hwTfLuna.getSignalStrength());
 }
 
+void test_hardware_uart_baud_rate() {
+    // Switch up and back, then find the rate without being told
+    TEST_ASSERT_TRUE(hwTfLuna.setBaudRate(460800));
+    TEST_ASSERT_TRUE(hwTfLuna.getData());
+    TEST_ASSERT_TRUE(hwTfLuna.setBaudRate(115200));
+    
+    HARDWARE_SERIAL.begin(9600);
+    TEST_ASSERT_EQUAL(115200, hwTfLuna.detectBaudRate());
+    TEST_ASSERT_TRUE(hwTfLuna.getData());
+}
+
 void test_hardware_i2c_init() {
     TFLuna i2cTfLuna;
-    TEST_ASSERT_TRUE(i2cTfLuna.beginI2C());
+    TEST_ASSERT_TRUE(i2cTfLuna.beginI2C(HARDWARE_I2C_ADDR));
     delay(100);
 }
 
 void test_hardware_i2c_data() {
     TFLuna i2cTfLuna;
-    i2cTfLuna.beginI2C();
+    i2cTfLuna.beginI2C(HARDWARE_I2C_ADDR);
     
     TEST_ASSERT_TRUE(i2cTfLuna.getDataI2C(HARDWARE_I2C_ADDR));
     
@@ -58,6 +76,118 @@ void test_hardware_i2c_data() {
     TEST_ASSERT_GREATER_OR_EQUAL(0, i2cTfLuna.getDistance());
 }
 
+void test_hardware_i2c_burst_read() {
+    TFLuna i2cTfLuna;
+    i2cTfLuna.beginI2C(HARDWARE_I2C_ADDR);
+    i2cTfLuna.resetBusTransactions();
+    
+    // One register transaction per sample instead of one per field
+    TEST_ASSERT_TRUE(i2cTfLuna.getDataI2C(HARDWARE_I2C_ADDR));
+    TEST_ASSERT_TRUE(i2cTfLuna.getDataI2C(HARDWARE_I2C_ADDR));
+    TEST_ASSERT_EQUAL(2, i2cTfLuna.getBusTransactions());
+}
+
+void test_hardware_i2c_register_cache() {
+    TFLuna i2cTfLuna;
+    i2cTfLuna.beginI2C(HARDWARE_I2C_ADDR);
+    
+    uint8_t uncachedVersion[3];
+    TEST_ASSERT_TRUE(i2cTfLuna.getFirmwareVersion(uncachedVersion, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_TRUE(i2cTfLuna.refreshRegisterCache(HARDWARE_I2C_ADDR));
+    
+    // Cached getters must not touch the bus and must agree with the device
+    uint8_t version[3];
+    uint16_t frameRate;
+    char code[14];
+    i2cTfLuna.resetBusTransactions();
+    TEST_ASSERT_TRUE(i2cTfLuna.getFirmwareVersion(version, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_TRUE(i2cTfLuna.getFrameRate(frameRate, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_TRUE(i2cTfLuna.getProductCode(code, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_EQUAL(0, i2cTfLuna.getBusTransactions());
+    TEST_ASSERT_EQUAL_MEMORY(uncachedVersion, version, 3);
+    
+    // Writes keep the mirror up to date
+    TEST_ASSERT_TRUE(i2cTfLuna.setFrameRateI2C(50, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_TRUE(i2cTfLuna.getFrameRate(frameRate, HARDWARE_I2C_ADDR));
+    TEST_ASSERT_EQUAL(50, frameRate);
+    TEST_ASSERT_TRUE(i2cTfLuna.isRegisterCacheValid(HARDWARE_I2C_ADDR));
+    
+    // A reset drops it
+    TEST_ASSERT_TRUE(i2cTfLuna.setSoftResetI2C(HARDWARE_I2C_ADDR));
+    TEST_ASSERT_FALSE(i2cTfLuna.isRegisterCacheValid(HARDWARE_I2C_ADDR));
+}
+
+void test_hardware_i2c_reset_time() {
+    TFLuna i2cTfLuna;
+    i2cTfLuna.beginI2C(HARDWARE_I2C_ADDR);
+    
+    // Returns as soon as the sensor answers again
+    uint32_t start = millis();
+    TEST_ASSERT_TRUE(i2cTfLuna.setSoftResetI2C(HARDWARE_I2C_ADDR));
+    uint32_t elapsed = millis() - start;
+    TEST_ASSERT_TRUE(elapsed < TFLUNA_RESET_TIMEOUT_MS);
+    TEST_ASSERT_TRUE(i2cTfLuna.getDataI2C(HARDWARE_I2C_ADDR));
+    
+    Serial.print("Soft reset took ");
+    Serial.print(elapsed);
+    Serial.println(" ms");
+}
+
+#ifdef HARDWARE_PARALLEL_BUSES
+#define PARALLEL_READS 500
+
+// Read PARALLEL_READS samples on each array, one thread per bus
+uint32_t timeParallelReads(TFLunaArray** arrays, uint8_t buses) {
+    std::thread threads[2];
+    uint32_t start = micros();
+    
+    for (uint8_t bus = 0; bus < buses; bus++) {
+        TFLunaArray* array = arrays[bus];
+        threads[bus] = std::thread([array]() {
+            for (uint16_t i = 0; i < PARALLEL_READS; i++) {
+                array->update();
+            }
+        });
+    }
+    for (uint8_t bus = 0; bus < buses; bus++) {
+        threads[bus].join();
+    }
+    
+    return micros() - start;
+}
+
+void test_hardware_parallel_buses() {
+    TFLunaArray first(&Wire);
+    TFLunaArray second(&HARDWARE_WIRE_2);
+    TFLunaArray* arrays[2] = {&first, &second};
+    
+    first.begin();
+    second.begin();
+    Wire.setClock(400000);
+    HARDWARE_WIRE_2.setClock(400000);
+    first.addSensor(HARDWARE_I2C_ADDR);
+    second.addSensor(HARDWARE_I2C_ADDR);
+    
+    // The same number of reads per bus should take about the same time with
+    // one bus or two, as each controller runs its transfers independently
+    uint32_t oneBus = timeParallelReads(arrays, 1);
+    uint32_t twoBuses = timeParallelReads(arrays, 2);
+    uint32_t speedupPercent = 2UL * oneBus * 100 / twoBuses;   // 200 is linear
+    
+    Serial.print("One bus: ");
+    Serial.print(PARALLEL_READS * 1000000.0 / oneBus);
+    Serial.print(" reads/s, two buses: ");
+    Serial.print(2 * PARALLEL_READS * 1000000.0 / twoBuses);
+    Serial.print(" reads/s, speedup: ");
+    Serial.print(speedupPercent / 100.0);
+    Serial.println("x");
+    
+    TEST_ASSERT_EQUAL(0, first.getErrorCount(0));
+    TEST_ASSERT_EQUAL(0, second.getErrorCount(0));
+    TEST_ASSERT_GREATER_OR_EQUAL(170, speedupPercent);
+}
+#endif
+
 void test_hardware_advanced_features() {
     hwTfLunaAdvanced.begin(115200);
     hwTfLunaAdvanced.enableMedianFilter(5);
@@ -92,11 +222,18 @@ void setup() {
 #ifdef ENABLE_HARDWARE_TESTS
     RUN_TEST(test_hardware_uart_init);
     RUN_TEST(test_hardware_uart_data);
+    //RUN_TEST(test_hardware_uart_baud_rate);
     
     // Only run I2C tests if pin 5 is connected to GND
     // Uncomment these if the sensor is in I2C mode
     //RUN_TEST(test_hardware_i2c_init);
     //RUN_TEST(test_hardware_i2c_data);
+    //RUN_TEST(test_hardware_i2c_burst_read);
+    //RUN_TEST(test_hardware_i2c_register_cache);
+    //RUN_TEST(test_hardware_i2c_reset_time);
+#ifdef HARDWARE_PARALLEL_BUSES
+    //RUN_TEST(test_hardware_parallel_buses);
+#endif
     
     RUN_TEST(test_hardware_advanced_features);
 #else
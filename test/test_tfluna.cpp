@@ -2,6 +2,12 @@
 #include <unity.h>
 #include <TFLuna.h>
 #include <TFLunaAdvanced.h>
+#include <TFLunaRingBuffer.h>
+#include <TFLunaFilters.h>
+#include <TFLunaTracker.h>
+#include <TFLunaArray.h>
+#include <TFLunaAutoTuner.h>
+#include <TFLunaCapture.h>
 
 // Mock classes for testing
 class MockStream : public Stream {
@@ -36,21 +42,368 @@ public:
     }
     
     size_t write(uint8_t data) override {
-        return 1;
+        return write(&data, 1);
     }
     
     size_t write(const uint8_t* buffer, size_t size) override {
+        // Keep the last command written to the sensor
+        _writtenLength = size < sizeof(_written) ? size : sizeof(_written);
+        memcpy(_written, buffer, _writtenLength);
         return size;
     }
     
+    const uint8_t* written() const {
+        return _written;
+    }
+    
+    size_t writtenLength() const {
+        return _writtenLength;
+    }
+    
 private:
+    uint8_t _written[16];
+    size_t _writtenLength = 0;
     uint8_t _buffer[256];
     size_t _available;
     size_t _readIndex;
 };
 
+// Log output capturing what is written, with a limited transmit buffer
+class LogStream : public Print {
+public:
+    void reset(int space) {
+        _length = 0;
+        _space = space;
+    }
+    
+    int availableForWrite() override {
+        return _space;
+    }
+    
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+    
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (_length + size > sizeof(_buffer)) {
+            size = sizeof(_buffer) - _length;
+        }
+        memcpy(&_buffer[_length], buffer, size);
+        _length += size;
+        _space = (size_t)_space > size ? _space - size : 0;
+        return size;
+    }
+    
+    const uint8_t* data() const {
+        return _buffer;
+    }
+    
+    size_t length() const {
+        return _length;
+    }
+    
+private:
+    uint8_t _buffer[512];
+    size_t _length = 0;
+    int _space = 0;
+};
+
+// Sensor array without hardware: each read takes 500 us and returns the
+// address as distance; reads of address 0x13 fail. Triggers take 200 us. Bus
+// operations are recorded, triggers with the top bit set.
+class MockArray : public TFLunaArray {
+public:
+    uint8_t events[64];
+    uint32_t eventMicros[64];
+    uint8_t eventCount = 0;
+    
+protected:
+    void _record(uint8_t event) {
+        if (eventCount < sizeof(events)) {
+            events[eventCount] = event;
+            eventMicros[eventCount] = micros();
+            eventCount++;
+        }
+    }
+    
+    bool _triggerSensor(uint8_t addr, uint8_t &errorCode) override {
+        delayMicroseconds(200);
+        _record(0x80 | addr);
+        errorCode = TFLUNA_OK;
+        return true;
+    }
+    
+    bool _readSensor(uint8_t addr, TFLuna::Sample &sample, uint8_t &errorCode) override {
+        delayMicroseconds(500);
+        _record(addr);
+        if (addr == 0x13) {
+            errorCode = TFLUNA_ERROR_I2C_NACK;
+            return false;
+        }
+        sample.distance = addr;
+        sample.strength = 1000;
+        sample.temperature = 2500;
+        sample.timestamp = 0;
+        sample.hostMicros = micros();
+        sample.sequence = 0;
+        errorCode = TFLUNA_OK;
+        return true;
+    }
+};
+
+// Sensor on a simulated UART link. Frames go out every 1/frameRate, or back
+// to back when the link is too slow for that; a port at another rate than the
+// sensor only receives noise. Baud rate commands are echoed at the old rate,
+// then the sensor switches; a factory reset goes back to 115200 baud, 100 Hz.
+class SimulatedSensor : public Stream {
+public:
+    uint32_t sensorBaud = 115200;
+    uint32_t portBaud = 115200;
+    uint16_t frameRate = 250;
+    bool followBaudCommand = true;    // False: echo the command but keep the rate
+    uint32_t triggers = 0;
+    
+    void restart() {
+        _start = micros();
+        _consumed = 0;
+    }
+    
+    int available() override {
+        if (_replyPending()) {
+            return _replyLength - _replyIndex;
+        }
+        return _sent() - _consumed;
+    }
+    
+    int read() override {
+        if (_replyPending()) {
+            return _reply[_replyIndex++];
+        }
+        if (_sent() <= _consumed) {
+            return -1;
+        }
+        uint32_t index = _consumed++;
+        if (portBaud != sensorBaud) {
+            return 0xFE;                  // Framing errors, never a header
+        }
+        uint8_t frame[TFLUNA_FRAME_LENGTH];
+        _makeFrame(frame, index / TFLUNA_FRAME_LENGTH);
+        return frame[index % TFLUNA_FRAME_LENGTH];
+    }
+    
+    int peek() override {
+        return -1;
+    }
+    
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+    
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (portBaud != sensorBaud || size < 4 || buffer[0] != 0x5A) {
+            return size;
+        }
+        if (buffer[2] == TFLUNA_CMD_TRIGGER) {
+            triggers++;
+            return size;                  // Continuous mode, nothing to do
+        }
+        
+        if (buffer[2] == TFLUNA_CMD_FACTORY_RESET) {
+            const uint8_t status[] = {0x5A, 0x05, TFLUNA_CMD_FACTORY_RESET, 0x00, 0x6F};
+            memcpy(_reply, status, sizeof(status));
+            _replyLength = sizeof(status);
+            _replyIndex = 0;
+            sensorBaud = 115200;
+            frameRate = 100;
+            restart();
+            return size;
+        }
+        
+        // Settings are echoed
+        memcpy(_reply, buffer, size);
+        _replyLength = size;
+        _replyIndex = 0;
+        if (buffer[2] == TFLUNA_CMD_BAUD_RATE && size == 8 && followBaudCommand) {
+            sensorBaud = buffer[3] | (buffer[4] << 8) | ((uint32_t)buffer[5] << 16) |
+                         ((uint32_t)buffer[6] << 24);
+            restart();
+        }
+        return size;
+    }
+    
+private:
+    // A reply goes out between two frames
+    bool _replyPending() {
+        return _replyLength > _replyIndex &&
+               (_replyIndex > 0 || _consumed % TFLUNA_FRAME_LENGTH == 0);
+    }
+    
+    // Bytes the sensor has finished sending
+    uint32_t _sent() {
+        uint64_t elapsed = micros() - _start;
+        uint64_t byteMicros = 10000000ULL / sensorBaud;
+        uint64_t frameMicros = byteMicros * TFLUNA_FRAME_LENGTH;
+        uint64_t period = 1000000ULL / frameRate;
+        if (period < frameMicros) {
+            period = frameMicros;
+        }
+        uint64_t frames = elapsed / period;
+        uint64_t bytes = (elapsed % period) / byteMicros;
+        if (bytes > TFLUNA_FRAME_LENGTH) {
+            bytes = TFLUNA_FRAME_LENGTH;
+        }
+        return frames * TFLUNA_FRAME_LENGTH + bytes;
+    }
+    
+    void _makeFrame(uint8_t* frame, uint32_t number) {
+        uint16_t distance = 100 + number % 100;
+        frame[0] = 0x59;
+        frame[1] = 0x59;
+        frame[2] = distance & 0xFF;
+        frame[3] = distance >> 8;
+        frame[4] = 0xE8;
+        frame[5] = 0x03;
+        frame[6] = 0x2C;
+        frame[7] = 0x01;
+        frame[8] = 0;
+        for (uint8_t i = 0; i < 8; i++) {
+            frame[8] += frame[i];
+        }
+    }
+    
+    uint32_t _start = 0;
+    uint32_t _consumed = 0;
+    uint8_t _reply[16];
+    uint8_t _replyLength = 0;
+    uint8_t _replyIndex = 0;
+};
+
+// TFLuna whose port rate is set on the simulated link
+class SimulatedTFLuna : public TFLuna {
+public:
+    SimulatedTFLuna(SimulatedSensor* link) : TFLuna((Stream*)link), _link(link) {}
+    
+protected:
+    bool _canSetPortBaud() const override {
+        return true;
+    }
+    
+    bool _setPortBaud(uint32_t baudRate) override {
+        _link->portBaud = baudRate;
+        return true;
+    }
+    
+private:
+    SimulatedSensor* _link;
+};
+
+// Frames decoded per second at the current rate
+uint32_t measureFrameRate(TFLuna &sensor) {
+    uint32_t frames = 0;
+    uint32_t start = millis();
+    while (millis() - start < 200) {
+        if (sensor.poll()) {
+            frames++;
+        }
+    }
+    return frames * 5;
+}
+
+// Tuner driving a simulated consumer: the sensor sends frames at the tuned
+// rate, the consumer needs processMicros per sample and whatever it cannot
+// keep up with is lost
+class SimulatedTuner : public TFLunaAutoTuner {
+public:
+    SimulatedTuner() : TFLunaAutoTuner(tfLunaForTuner) {}
+    
+    uint16_t deviceRate = 0;
+    uint32_t processMicros = 1000;
+    
+    // Run one window of windowMs, returns true when the rate changed
+    bool runWindow(uint16_t windowMs) {
+        uint32_t sent = (uint32_t)deviceRate * windowMs / 1000;
+        uint32_t capacity = (uint32_t)windowMs * 1000 / processMicros;
+        uint32_t handled = sent < capacity ? sent : capacity;
+        TFLuna::Sample sample = {};
+        for (uint32_t i = 0; i < handled; i++) {
+            recordSample(sample, processMicros);
+        }
+        delay(windowMs);
+        return update();
+    }
+    
+protected:
+    static TFLuna tfLunaForTuner;
+    
+    bool _applyRate(uint16_t rate) override {
+        deviceRate = rate;
+        return true;
+    }
+};
+
+TFLuna SimulatedTuner::tfLunaForTuner;
+
+// Sensor array whose devices come back from a reset at set times
+class RestartingArray : public TFLunaArray {
+public:
+    uint32_t readyAt[4] = {0, 0, 0, 0};     // millis(), 0 never answers
+    uint32_t probes = 0;
+    
+protected:
+    bool _resetSensor(uint8_t addr, uint8_t &errorCode) override {
+        errorCode = TFLUNA_OK;
+        return true;
+    }
+    
+    bool _probeSensor(uint8_t addr) override {
+        probes++;
+        uint32_t at = readyAt[addr - 0x10];
+        return at != 0 && millis() >= at;
+    }
+};
+
+// Build a valid UART frame for the given distance
+void makeFrame(uint8_t* frame, uint16_t distance) {
+    frame[0] = 0x59;
+    frame[1] = 0x59;
+    frame[2] = distance & 0xFF;
+    frame[3] = distance >> 8;
+    frame[4] = 0xE8;                // Strength: 1000
+    frame[5] = 0x03;
+    frame[6] = 0x2C;                // Temperature: 300 (3.00°C)
+    frame[7] = 0x01;
+    frame[8] = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        frame[8] += frame[i];
+    }
+}
+
+// Build a command reply with its checksum, returns the frame length
+uint8_t makeReply(uint8_t* reply, uint8_t command, const uint8_t* data, uint8_t dataLen) {
+    uint8_t length = dataLen + 4;
+    reply[0] = 0x5A;
+    reply[1] = length;
+    reply[2] = command;
+    memcpy(&reply[3], data, dataLen);
+    reply[length - 1] = 0;
+    for (uint8_t i = 0; i < length - 1; i++) {
+        reply[length - 1] += reply[i];
+    }
+    return length;
+}
+
+// Last completion reported to commandCallback()
+uint8_t callbackTicket = 0;
+uint8_t callbackError = 0xFF;
+
+void commandCallback(uint8_t ticket, uint8_t command, uint8_t errorCode) {
+    callbackTicket = ticket;
+    callbackError = errorCode;
+}
+
 // Global variables for tests
 MockStream mockStream;
+LogStream logStream;
 TFLuna tfLuna(&mockStream);
 TFLunaAdvanced tfLunaAdvanced(&mockStream);
 
@@ -60,6 +413,14 @@ void test_constructor() {
     TEST_ASSERT_EQUAL(0, tfLuna.getSignalStrength());
     TEST_ASSERT_EQUAL(0, tfLuna.getTemperature());
     TEST_ASSERT_EQUAL(0, tfLuna.getErrorCode());
+    
+    // I2C instances use the global bus unless given another controller
+    TFLuna onDefaultBus;
+    TEST_ASSERT_TRUE(onDefaultBus.getWire() == &Wire);
+#if defined(WIRE_INTERFACES_COUNT) && WIRE_INTERFACES_COUNT > 1
+    TFLuna onSecondBus(&Wire1);
+    TEST_ASSERT_TRUE(onSecondBus.getWire() == &Wire1);
+#endif
 }
 
 void test_uart_data_parsing() {
@@ -69,7 +430,7 @@ void test_uart_data_parsing() {
         0x64, 0x00,             // Distance: 100 cm
         0xE8, 0x03,             // Strength: 1000
         0x2C, 0x01,             // Temperature: 300 (3.00°C)
-        0x2D                    // Checksum
+        0x2E                    // Checksum
     };
     
     // Set the mock data
@@ -101,6 +462,282 @@ void test_uart_invalid_checksum() {
     TEST_ASSERT_EQUAL(2, tfLuna.getErrorCode()); // TFLUNA_ERROR_CHECKSUM
 }
 
+void test_uart_incremental_parser() {
+    uint8_t frame[] = {
+        0x59, 0x59,             // Header
+        0xC8, 0x00,             // Distance: 200 cm
+        0xE8, 0x03,             // Strength: 1000
+        0x2C, 0x01,             // Temperature: 300 (3.00°C)
+        0x92                    // Checksum
+    };
+    
+    // First part of the frame, preceded by a stray byte: nothing ready yet
+    uint8_t firstPart[] = { 0x00, 0x59, 0x59, 0xC8 };
+    mockStream.setData(firstPart, sizeof(firstPart));
+    TEST_ASSERT_FALSE(tfLuna.poll());
+    TEST_ASSERT_EQUAL(0, mockStream.available());
+    
+    // Remainder completes the frame on the next poll
+    mockStream.setData(frame + 3, sizeof(frame) - 3);
+    TEST_ASSERT_TRUE(tfLuna.poll());
+    TEST_ASSERT_EQUAL(200, tfLuna.getDistance());
+    TEST_ASSERT_EQUAL(1000, tfLuna.getSignalStrength());
+    
+    // Byte-wise feeding reports the frame exactly once, on the checksum byte
+    for (uint8_t i = 0; i < sizeof(frame) - 1; i++) {
+        TEST_ASSERT_FALSE(tfLuna.feed(frame[i]));
+    }
+    TEST_ASSERT_TRUE(tfLuna.feed(frame[sizeof(frame) - 1]));
+}
+
+void test_uart_batch_decode() {
+    uint8_t buffer[] = {
+        0x59, 0x59, 0x64, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x2E,   // 100 cm
+        0x59, 0x59, 0xC8, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0xFF,   // Bad checksum
+        0x59, 0x59, 0xC8, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x92,   // 200 cm
+        0x59, 0x59, 0x2C, 0x01                                  // 300 cm, partial
+    };
+    uint8_t rest[] = { 0xE8, 0x03, 0x2C, 0x01, 0xF7 };
+    TFLuna::Sample samples[4];
+    size_t consumed = 0;
+    size_t dropped = 0;
+    
+    TEST_ASSERT_EQUAL(2, tfLuna.decodeFrames(buffer, sizeof(buffer), samples, 4, consumed, dropped));
+    TEST_ASSERT_EQUAL(sizeof(buffer), consumed);
+    TEST_ASSERT_EQUAL(1, dropped);
+    TEST_ASSERT_EQUAL(100, samples[0].distance);
+    TEST_ASSERT_EQUAL(200, samples[1].distance);
+    TEST_ASSERT_EQUAL(200, tfLuna.getDistance());
+    
+    // The partial frame is carried over to the next call
+    TEST_ASSERT_EQUAL(1, tfLuna.decodeFrames(rest, sizeof(rest), samples, 4, consumed, dropped));
+    TEST_ASSERT_EQUAL(sizeof(rest), consumed);
+    TEST_ASSERT_EQUAL(0, dropped);
+    TEST_ASSERT_EQUAL(300, samples[0].distance);
+    TEST_ASSERT_EQUAL(1000, samples[0].strength);
+    TEST_ASSERT_EQUAL(300, samples[0].temperature);
+}
+
+void test_timestamped_sample() {
+    uint8_t frames[] = {
+        0x59, 0x59, 0x64, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x2E,   // 100 cm
+        0x59, 0x59, 0xC8, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0xFF,   // Bad checksum
+        0x59, 0x59, 0xC8, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x92    // 200 cm
+    };
+    TFLuna::Sample first;
+    TFLuna::Sample second;
+    
+    mockStream.setData(frames, sizeof(frames));
+    TEST_ASSERT_TRUE(tfLuna.read(first));
+    TEST_ASSERT_EQUAL(100, first.distance);
+    TEST_ASSERT_EQUAL(1000, first.strength);
+    TEST_ASSERT_EQUAL(300, first.temperature);
+    
+    // The rejected frame in between shows up as a sequence gap
+    TEST_ASSERT_TRUE(tfLuna.read(second));
+    TEST_ASSERT_EQUAL(200, second.distance);
+    TEST_ASSERT_EQUAL(first.sequence + 2, second.sequence);
+    TEST_ASSERT_TRUE(second.hostMicros - first.hostMicros < 0x80000000UL);
+    TEST_ASSERT_EQUAL(17, sizeof(TFLuna::Sample));
+}
+
+void test_sample_ring() {
+    TFLunaSampleRing<3> ring;
+    TFLuna::Sample sample = { 100, 1000, 300, 0, 0, 0, TFLUNA_UNIT_CM };
+    TFLuna::Sample out[4];
+    
+    // Full at capacity, further samples are dropped and counted
+    for (uint16_t i = 0; i < 4; i++) {
+        sample.distance = 100 + i;
+        ring.push(sample);
+    }
+    TEST_ASSERT_EQUAL(3, ring.size());
+    TEST_ASSERT_EQUAL(1, ring.getOverflowCount());
+    
+    TEST_ASSERT_TRUE(ring.pop(out[0]));
+    TEST_ASSERT_EQUAL(100, out[0].distance);
+    TEST_ASSERT_EQUAL(2, ring.popBatch(out, 4));
+    TEST_ASSERT_EQUAL(102, out[1].distance);
+    TEST_ASSERT_TRUE(ring.isEmpty());
+    
+    // fill() queues every frame the parser completes
+    uint8_t frames[] = {
+        0x59, 0x59, 0x64, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x2E,   // 100 cm
+        0x59, 0x59, 0xC8, 0x00, 0xE8, 0x03, 0x2C, 0x01, 0x92    // 200 cm
+    };
+    mockStream.setData(frames, sizeof(frames));
+    TEST_ASSERT_EQUAL(2, ring.fill(tfLuna));
+    TEST_ASSERT_EQUAL(2, ring.popBatch(out, 4));
+    TEST_ASSERT_EQUAL(100, out[0].distance);
+    TEST_ASSERT_EQUAL(200, out[1].distance);
+}
+
+void test_streaming_median() {
+    // Compare against sorting the last N values for every permitted window
+    for (uint8_t window = 3; window <= 15; window += 2) {
+        TFLunaMedianFilter<15> median;
+        median.setWindow(window);
+        uint16_t history[64];
+        uint32_t seed = window;
+        
+        for (uint8_t i = 0; i < 64; i++) {
+            seed = seed * 1103515245UL + 12345UL;
+            history[i] = (seed >> 16) % 50 + 100;   // Plenty of duplicates
+            uint16_t result = median.process(history[i]);
+            
+            if (i + 1 < window) {
+                TEST_ASSERT_EQUAL(history[i], result);
+                continue;
+            }
+            
+            uint16_t sorted[15];
+            memcpy(sorted, &history[i + 1 - window], window * sizeof(uint16_t));
+            for (uint8_t a = 1; a < window; a++) {
+                for (uint8_t b = a; b > 0 && sorted[b - 1] > sorted[b]; b--) {
+                    uint16_t temp = sorted[b];
+                    sorted[b] = sorted[b - 1];
+                    sorted[b - 1] = temp;
+                }
+            }
+            TEST_ASSERT_EQUAL(sorted[window / 2], result);
+        }
+    }
+}
+
+void test_median_average_chain() {
+    TFLunaAdvanced chained(&mockStream);
+    chained.enableMedianFilter(3);
+    chained.enableAverageFilter(2);
+    
+    // Median passes raw values until full, the average then smooths its output
+    uint16_t distances[] = { 100, 200, 300, 100, 1000, 100 };
+    uint16_t expected[]  = { 100, 150, 200, 200,  250, 200 };
+    uint8_t frame[TFLUNA_FRAME_LENGTH];
+    
+    for (uint8_t i = 0; i < 6; i++) {
+        makeFrame(frame, distances[i]);
+        mockStream.setData(frame, sizeof(frame));
+        TEST_ASSERT_TRUE(chained.getData());
+        TEST_ASSERT_EQUAL(expected[i], chained.getDistance());
+    }
+    
+    // Running sum matches a plain average, including sums above 16 bits
+    TFLunaMeanFilter<20> mean;
+    mean.setWindow(4);
+    uint16_t values[] = { 10, 20, 30, 40, 50, 60000, 60000, 60000, 60000 };
+    for (uint8_t i = 0; i < 9; i++) {
+        uint16_t result = mean.process(values[i]);
+        if (i >= 3) {
+            uint32_t sum = (uint32_t)values[i] + values[i - 1] + values[i - 2] + values[i - 3];
+            TEST_ASSERT_EQUAL(sum / 4, result);
+        }
+    }
+}
+
+void test_filter_pipeline() {
+    TFLunaFilterPipeline<TFLunaOutlierGate<50, 2>,
+                         TFLunaDeadbandFilter<2>,
+                         TFLunaEMAFilter<128> > pipeline;
+    
+    TEST_ASSERT_EQUAL(100, pipeline.process(100));
+    TEST_ASSERT_EQUAL(100, pipeline.process(101));     // Inside the deadband
+    TEST_ASSERT_EQUAL(102, pipeline.process(104));     // Halfway towards 104
+    TEST_ASSERT_EQUAL(103, pipeline.process(400));     // Spike gated out
+    TEST_ASSERT_EQUAL(1, pipeline.stage<0>().getRejectCount());
+    pipeline.process(400);
+    TEST_ASSERT_EQUAL(252, pipeline.process(400));     // Persistent step accepted
+    
+    // A pipeline is exactly its stages, no hidden state
+    TEST_ASSERT_TRUE(sizeof(TFLunaAdvanced::Filters) <=
+                     sizeof(TFLunaMedianFilter<TFLUNA_MEDIAN_MAX_WINDOW>) +
+                     sizeof(TFLunaMeanFilter<TFLUNA_AVERAGE_MAX_WINDOW>) + 4);
+    
+    pipeline.reset();
+    TEST_ASSERT_EQUAL(500, pipeline.process(500));
+}
+
+void test_tracker_against_reference() {
+    // Double-precision alpha-beta filter with the gains used for strength 500
+    const double alpha = 128 / 256.0;
+    const double beta = 44 / 256.0;
+    const double period = 1.0 / 100;
+    double refPosition = 0;
+    double refVelocity = 0;
+    
+    TFLunaTracker tracker(100);
+    uint32_t seed = 42;
+    double maxPositionError = 0;
+    double maxVelocityError = 0;
+    
+    for (uint16_t i = 0; i < 500; i++) {
+        // Target approaching and receding at up to 80 cm/s, with +-4 cm noise
+        double truth = 300 + 120 * sin(i * 0.02 * 3.14159265);
+        seed = seed * 1103515245UL + 12345UL;
+        uint16_t measured = (uint16_t)(truth + (int)((seed >> 16) % 9) - 4 + 0.5);
+        
+        tracker.update(measured, 500);
+        
+        if (i == 0) {
+            refPosition = measured;
+            refVelocity = 0;
+            continue;
+        }
+        double predicted = refPosition + refVelocity * period;
+        double residual = measured - predicted;
+        refPosition = predicted + alpha * residual;
+        refVelocity = refVelocity + beta * residual / period;
+        
+        double positionError = fabs(tracker.getDistanceQ4() / 16.0 - refPosition);
+        double velocityError = fabs(tracker.getVelocityQ4() / 16.0 - refVelocity);
+        maxPositionError = positionError > maxPositionError ? positionError : maxPositionError;
+        maxVelocityError = velocityError > maxVelocityError ? velocityError : maxVelocityError;
+    }
+    
+    TEST_ASSERT_TRUE(maxPositionError < 0.25);
+    TEST_ASSERT_TRUE(maxVelocityError < 2.0);
+    
+    // Constant approach is tracked without lag once settled
+    tracker.reset();
+    for (uint16_t i = 0; i < 200; i++) {
+        tracker.update(600 - i, 2000);  // -100 cm/s at 100 Hz
+    }
+    TEST_ASSERT_INT_WITHIN(1, -100, tracker.getVelocity());
+    TEST_ASSERT_INT_WITHIN(1, 401, tracker.getDistance());
+    
+    // A lost frame is bridged by prediction
+    TFLuna::Sample sample = { 300, 2000, 0, 0, 0, 1, TFLUNA_UNIT_CM };
+    tracker.reset();
+    for (uint8_t i = 0; i < 100; i++) {
+        sample.distance = 300 + i;
+        sample.sequence = i + 1;
+        tracker.update(sample);
+    }
+    sample.distance = 401;
+    sample.sequence = 102;
+    TEST_ASSERT_INT_WITHIN(1, 401, tracker.update(sample));
+    TEST_ASSERT_INT_WITHIN(2, 100, tracker.getVelocity());
+    
+    // Small residuals after a gap still correct the velocity, spread over the
+    // bridged frames (weak signal: alpha 51, beta 6)
+    for (uint8_t steps = 2; steps <= TFLUNA_TRACKER_MAX_GAP; steps++) {
+        for (int8_t offset = -3; offset <= 3; offset++) {
+            tracker.reset();
+            for (uint8_t i = 0; i < 100; i++) {
+                tracker.update(300 + i, 50);
+            }
+            double position = tracker.getDistanceQ4() / 16.0;
+            double velocity = tracker.getVelocityQ4() / 16.0;
+            double predicted = position + velocity * period * steps;
+            uint16_t measured = (uint16_t)(predicted + 0.5) + offset;
+            double residual = measured - predicted;
+            double refVelocity = velocity + (6 / 256.0) * residual / period / steps;
+            
+            tracker.update(measured, 50, steps);
+            TEST_ASSERT_TRUE(fabs(tracker.getVelocityQ4() / 16.0 - refVelocity) < 0.25);
+        }
+    }
+}
+
 void test_advanced_filters() {
     // Enable median filter
     tfLunaAdvanced.enableMedianFilter(3);
@@ -111,7 +748,7 @@ void test_advanced_filters() {
         0x64, 0x00,             // Distance: 100 cm
         0xE8, 0x03,             // Strength: 1000
         0x2C, 0x01,             // Temperature: 300 (3.00°C)
-        0x2D                    // Checksum
+        0x2E                    // Checksum
     };
     
     uint8_t frame2[] = {
@@ -119,7 +756,7 @@ void test_advanced_filters() {
         0xC8, 0x00,             // Distance: 200 cm
         0xE8, 0x03,             // Strength: 1000
         0x2C, 0x01,             // Temperature: 300 (3.00°C)
-        0x91                    // Checksum
+        0x92                    // Checksum
     };
     
     uint8_t frame3[] = {
@@ -127,7 +764,7 @@ void test_advanced_filters() {
         0x2C, 0x01,             // Distance: 300 cm
         0xE8, 0x03,             // Strength: 1000
         0x2C, 0x01,             // Temperature: 300 (3.00°C)
-        0xF5                    // Checksum
+        0xF7                    // Checksum
     };
     
     // Send first frame
@@ -154,6 +791,946 @@ void test_advanced_filters() {
     TEST_ASSERT_FLOAT_WITHIN(0.01, 37.4, tfLunaAdvanced.getTemperatureInFahrenheit());
 }
 
+void test_fixed_point_conversions() {
+    tfLunaAdvanced.disableMedianFilter();
+    tfLunaAdvanced.disableAverageFilter();
+    
+    uint8_t frame[] = {
+        0x59, 0x59,             // Header
+        0xC8, 0x00,             // Distance: 200 cm
+        0xE8, 0x03,             // Strength: 1000
+        0x2C, 0x01,             // Temperature: 300 (3.00°C)
+        0x92                    // Checksum
+    };
+    mockStream.setData(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(tfLunaAdvanced.getData());
+    
+    TEST_ASSERT_EQUAL_UINT32(2000, tfLunaAdvanced.getDistanceInMillimeters());
+    TEST_ASSERT_UINT32_WITHIN(2, 131072, tfLunaAdvanced.getDistanceInMetersQ16());   // 2.0 m
+    TEST_ASSERT_UINT32_WITHIN(2, 20157, tfLunaAdvanced.getDistanceInInchesQ8());     // 78.74 in
+    TEST_ASSERT_EQUAL_INT32(3740, tfLunaAdvanced.getTemperatureInCentiFahrenheit());
+    TEST_ASSERT_EQUAL_UINT8(49, tfLunaAdvanced.getSignalQuality());
+    
+    // Quality must match the original integer formula over the whole range
+    TFLuna::Sample samples[4] = {};
+    uint8_t quality[4];
+    for (uint16_t strength = 0; strength <= 2100; strength += 4) {
+        for (uint8_t i = 0; i < 4; i++) {
+            samples[i].strength = strength + i;
+        }
+        TFLunaAdvanced::toSignalQuality(samples, quality, 4);
+        for (uint8_t i = 0; i < 4; i++) {
+            uint16_t s = strength + i;
+            uint8_t expected = s < 30 ? 0 : s > 2000 ? 100 : (uint8_t)((uint32_t)(s - 30) * 100 / 1970);
+            TEST_ASSERT_EQUAL_UINT8(expected, quality[i]);
+        }
+    }
+    
+    // Batch conversions agree with the float reference
+    int16_t temperatures[4] = {-2000, -1, 0, 8000};
+    uint16_t distances[4] = {0, 1, 800, 12000};
+    uint32_t millimeters[4];
+    uint32_t meters[4];
+    int32_t fahrenheit[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        samples[i].distance = distances[i];
+        samples[i].temperature = temperatures[i];
+    }
+    TFLunaAdvanced::toMillimeters(samples, millimeters, 4);
+    TFLunaAdvanced::toMetersQ16(samples, meters, 4);
+    TFLunaAdvanced::toCentiFahrenheit(samples, fahrenheit, 4);
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)distances[i] * 10, millimeters[i]);
+        TEST_ASSERT_FLOAT_WITHIN(0.001, distances[i] / 100.0f, meters[i] / 65536.0f);
+        TEST_ASSERT_FLOAT_WITHIN(1.0, temperatures[i] * 1.8f + 3200.0f, (float)fahrenheit[i]);
+    }
+}
+
+void test_binary_logging() {
+    uint8_t frames[4 * TFLUNA_FRAME_LENGTH];
+    for (uint8_t i = 0; i < 4; i++) {
+        makeFrame(&frames[i * TFLUNA_FRAME_LENGTH], 100 + i);
+    }
+    
+    // Transmit buffer full: records stay in RAM, nothing blocks
+    TFLunaAdvanced logged(&mockStream);
+    logStream.reset(TFLUNA_LOG_BUFFER_SIZE);
+    logged.beginLogging(&logStream, TFLUNA_LOG_BINARY);
+    logStream.reset(0);
+    mockStream.setData(frames, sizeof(frames));
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(logged.getData());
+    }
+    TEST_ASSERT_EQUAL(0, logStream.length());
+    
+    // Room for one and a half records per flush
+    logStream.reset(TFLUNA_LOG_RECORD_LENGTH * 3 / 2);
+    TEST_ASSERT_EQUAL(TFLUNA_LOG_RECORD_LENGTH * 3 / 2, logged.flushLog());
+    logged.endLogging();
+    TEST_ASSERT_EQUAL(4 * TFLUNA_LOG_RECORD_LENGTH, logStream.length());
+    TEST_ASSERT_EQUAL(0, logged.getDroppedLogRecords());
+    
+    // Records decode back to the samples
+    for (uint8_t i = 0; i < 4; i++) {
+        const uint8_t* record = logStream.data() + i * TFLUNA_LOG_RECORD_LENGTH;
+        TEST_ASSERT_EQUAL_HEX8(TFLUNA_LOG_SYNC1, record[0]);
+        TEST_ASSERT_EQUAL_HEX8(TFLUNA_LOG_SYNC2, record[1]);
+        
+        TFLuna::Sample sample;
+        memcpy(&sample, &record[2], sizeof(sample));
+        TEST_ASSERT_EQUAL(100 + i, sample.distance);
+        TEST_ASSERT_EQUAL(1000, sample.strength);
+        TEST_ASSERT_EQUAL(300, sample.temperature);
+        TEST_ASSERT_EQUAL(i + 1, sample.sequence);
+        TEST_ASSERT_EQUAL(TFLUNA_OK, record[TFLUNA_LOG_RECORD_LENGTH - 2]);
+        
+        uint8_t checksum = 0;
+        for (uint8_t j = 0; j < TFLUNA_LOG_RECORD_LENGTH - 1; j++) {
+            checksum += record[j];
+        }
+        TEST_ASSERT_EQUAL_HEX8(checksum, record[TFLUNA_LOG_RECORD_LENGTH - 1]);
+    }
+    
+    // A full buffer drops whole records and counts them
+    logStream.reset(TFLUNA_LOG_BUFFER_SIZE);
+    logged.beginLogging(&logStream, TFLUNA_LOG_BINARY);
+    logStream.reset(0);
+    uint8_t fit = TFLUNA_LOG_BUFFER_SIZE / TFLUNA_LOG_RECORD_LENGTH;
+    for (uint8_t i = 0; i <= fit; i++) {
+        mockStream.setData(frames, TFLUNA_FRAME_LENGTH);
+        logged.getData();
+    }
+    TEST_ASSERT_EQUAL(1, logged.getDroppedLogRecords());
+    logStream.reset(TFLUNA_LOG_BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(fit * TFLUNA_LOG_RECORD_LENGTH, logged.flushLog());
+    logged.endLogging();
+    
+    // An output that never reports space (the Print default) is written to
+    // directly, a bounded amount per flush
+    TFLunaAdvanced direct(&mockStream);
+    logStream.reset(0);
+    direct.beginLogging(&logStream, TFLUNA_LOG_BINARY);
+    mockStream.setData(frames, sizeof(frames));
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(direct.getData());
+    }
+    TEST_ASSERT_EQUAL(4 * TFLUNA_LOG_RECORD_LENGTH, logStream.length());
+    TEST_ASSERT_EQUAL(0, direct.getDroppedLogRecords());
+    direct.endLogging();
+}
+
+void test_text_logging() {
+    uint8_t frame[TFLUNA_FRAME_LENGTH];
+    makeFrame(frame, 123);
+    
+    TFLunaAdvanced logged(&mockStream);
+    logStream.reset(64);
+    logged.beginLogging(&logStream);   // Text is the default
+    mockStream.setData(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(logged.getData());
+    logged.endLogging();
+    
+    const char expected[] = "Distance: 123 cm, Strength: 1000, Temp: 3.00 \xC2\xB0" "C\r\n";
+    TEST_ASSERT_EQUAL(sizeof(expected) - 1, logStream.length());
+    TEST_ASSERT_EQUAL_MEMORY(expected, logStream.data(), sizeof(expected) - 1);
+}
+
+void test_sensor_array() {
+    MockArray array;
+    TEST_ASSERT_TRUE(array.addSensor(0x10));
+    TEST_ASSERT_TRUE(array.addSensor(0x11));
+    TEST_ASSERT_TRUE(array.addSensor(0x13));
+    TEST_ASSERT_FALSE(array.addSensor(0x14, TFLUNA_ARRAY_MAX_RATE + 1));
+    TEST_ASSERT_EQUAL(3, array.getSensorCount());
+    
+    // Round robin visits every sensor in turn
+    for (uint8_t i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL(i % 3, array.update());
+    }
+    TEST_ASSERT_EQUAL_HEX8(0x07, array.takeUpdatedMask());
+    TEST_ASSERT_EQUAL(0, array.takeUpdatedMask());
+    TEST_ASSERT_EQUAL(0x10, array.getSamples()[0].distance);
+    TEST_ASSERT_EQUAL(0x11, array.getSample(1).distance);
+    TEST_ASSERT_EQUAL(2, array.getSample(1).sequence);
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_I2C_NACK, array.getErrorCode(2));
+    TEST_ASSERT_EQUAL(2, array.getErrorCount(2));
+    
+    // Rate mode over two statistics windows: 100 Hz, 40 Hz and whatever is left
+    MockArray paced;
+    paced.addSensor(0x10, 100);
+    paced.addSensor(0x11, 40);
+    paced.addSensor(0x12);
+    paced.setSchedule(TFLUNA_ARRAY_RATE);
+    paced.resetStatistics();
+    
+    uint16_t reads[3] = {0, 0, 0};
+    uint32_t start = millis();
+    while (millis() - start < 2 * TFLUNA_ARRAY_STATS_WINDOW_MS) {
+        uint8_t index = paced.update();
+        TEST_ASSERT_NOT_EQUAL(TFLUNA_ARRAY_NONE, index);  // The unpaced sensor fills the gaps
+        reads[index]++;
+    }
+    TEST_ASSERT_INT_WITHIN(4, 200, reads[0]);
+    TEST_ASSERT_INT_WITHIN(4, 80, reads[1]);
+    TEST_ASSERT_INT_WITHIN(5, 100, paced.getAchievedRate(0));
+    TEST_ASSERT_INT_WITHIN(5, 40, paced.getAchievedRate(1));
+    TEST_ASSERT_TRUE(paced.getAchievedRate(2) > 1000);
+    TEST_ASSERT_TRUE(paced.getBusUtilisation() >= 90);
+    
+    // Without an unpaced sensor the bus is left idle between deadlines
+    MockArray idle;
+    idle.addSensor(0x10, 100);
+    idle.setSchedule(TFLUNA_ARRAY_RATE);
+    TEST_ASSERT_EQUAL(0, idle.update());
+    TEST_ASSERT_EQUAL(TFLUNA_ARRAY_NONE, idle.update());
+}
+
+void test_sensor_array_triggered() {
+    // Four sensors, 2 ms measurement: pipelined against trigger-wait-read
+    MockArray pipelined;
+    MockArray serial;
+    for (uint8_t i = 0; i < 4; i++) {
+        pipelined.addSensor(0x20 + i);
+        serial.addSensor(0x20 + i);
+    }
+    pipelined.setMeasurementTime(2000);
+    serial.setMeasurementTime(2000);
+    serial.setMaxInFlight(1);
+    pipelined.setSchedule(TFLUNA_ARRAY_TRIGGERED);
+    serial.setSchedule(TFLUNA_ARRAY_TRIGGERED);
+    pipelined.resetStatistics();
+    serial.resetStatistics();
+    
+    uint32_t readsPipelined = 0;
+    uint32_t readsSerial = 0;
+    uint32_t start = millis();
+    while (millis() - start < TFLUNA_ARRAY_STATS_WINDOW_MS + 10) {
+        readsPipelined += pipelined.update() != TFLUNA_ARRAY_NONE;
+    }
+    start = millis();
+    while (millis() - start < TFLUNA_ARRAY_STATS_WINDOW_MS + 10) {
+        readsSerial += serial.update() != TFLUNA_ARRAY_NONE;
+    }
+    
+    // All four are triggered back to back, then each is read once its
+    // measurement is done and immediately triggered again
+    const uint8_t expected[] = {0xA0, 0xA1, 0xA2, 0xA3, 0x20, 0xA0, 0x21, 0xA1, 0x22, 0xA2};
+    TEST_ASSERT_EQUAL_MEMORY(expected, pipelined.events, sizeof(expected));
+    
+    // Every read follows its own trigger after the measurement time, and at
+    // most one sensor integrates at a time in serial mode
+    uint32_t triggeredAt[4] = {0, 0, 0, 0};
+    bool measuring[4] = {false, false, false, false};
+    for (uint8_t e = 0; e < pipelined.eventCount; e++) {
+        uint8_t sensor = (pipelined.events[e] & 0x7F) - 0x20;
+        if (pipelined.events[e] & 0x80) {
+            TEST_ASSERT_FALSE(measuring[sensor]);
+            measuring[sensor] = true;
+            triggeredAt[sensor] = pipelined.eventMicros[e];
+        } else {
+            TEST_ASSERT_TRUE(measuring[sensor]);
+            TEST_ASSERT_TRUE(pipelined.eventMicros[e] - triggeredAt[sensor] >= 2000);
+            measuring[sensor] = false;
+        }
+    }
+    for (uint8_t e = 0; e + 1 < serial.eventCount; e += 2) {
+        TEST_ASSERT_EQUAL(serial.events[e] & 0x7F, serial.events[e + 1]);
+        TEST_ASSERT_TRUE(serial.events[e] & 0x80);
+    }
+    
+    // Serial: 200 + 2000 + 500 us per sample. Pipelined: the bus stays busy.
+    uint32_t aggregate = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        aggregate += pipelined.getAchievedRate(i);
+        TEST_ASSERT_INT_WITHIN(20, 1000000 / 2700 / 4, serial.getAchievedRate(i));
+    }
+    TEST_ASSERT_TRUE(aggregate > 3 * readsSerial);
+    TEST_ASSERT_INT_WITHIN(40, 1000000 / 700, aggregate);
+    TEST_ASSERT_TRUE(pipelined.getBusUtilisation() >= 90);
+    TEST_ASSERT_TRUE(serial.getBusUtilisation() < 30);
+    TEST_ASSERT_TRUE(readsPipelined > 1000);
+}
+
+void test_async_commands() {
+    TFLuna sensor(&mockStream);
+    uint8_t stream[40];
+    uint8_t rate[2] = {0x0A, 0x00};      // 10 Hz
+    
+    // The command goes out as soon as it is queued
+    uint8_t ticket = sensor.queueCommand(TFLUNA_CMD_FRAME_RATE, rate, 2, commandCallback);
+    TEST_ASSERT_NOT_EQUAL(0, ticket);
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_SENT, sensor.getCommandStatus(ticket));
+    const uint8_t expected[] = {0x5A, 0x06, 0x03, 0x0A, 0x00, 0x6D};
+    TEST_ASSERT_EQUAL(sizeof(expected), mockStream.writtenLength());
+    TEST_ASSERT_EQUAL_MEMORY(expected, mockStream.written(), sizeof(expected));
+    
+    // The reply is picked out from between data frames, which still decode
+    makeFrame(stream, 100);
+    uint8_t length = TFLUNA_FRAME_LENGTH;
+    length += makeReply(&stream[length], TFLUNA_CMD_FRAME_RATE, rate, 2);
+    makeFrame(&stream[length], 200);
+    length += TFLUNA_FRAME_LENGTH;
+    mockStream.setData(stream, length);
+    
+    TEST_ASSERT_TRUE(sensor.poll());
+    TEST_ASSERT_EQUAL(100, sensor.getDistance());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_SENT, sensor.getCommandStatus(ticket));
+    TEST_ASSERT_TRUE(sensor.poll());
+    TEST_ASSERT_EQUAL(200, sensor.getDistance());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_DONE, sensor.getCommandStatus(ticket));
+    TEST_ASSERT_EQUAL(ticket, callbackTicket);
+    TEST_ASSERT_EQUAL(TFLUNA_OK, callbackError);
+    TEST_ASSERT_FALSE(sensor.isCommandPending());
+    
+    // A wrong echo fails the command
+    uint8_t other[2] = {0x14, 0x00};
+    ticket = sensor.queueCommand(TFLUNA_CMD_FRAME_RATE, rate, 2, commandCallback);
+    length = makeReply(stream, TFLUNA_CMD_FRAME_RATE, other, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_FALSE(sensor.poll());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_FAILED, sensor.getCommandStatus(ticket));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_COMMAND, sensor.getCommandError(ticket));
+    
+    // A stray reply header just before the reply does not hide it
+    ticket = sensor.queueCommand(TFLUNA_CMD_FRAME_RATE, rate, 2, commandCallback);
+    stream[0] = TFLUNA_CMD_HEADER;
+    length = 1 + makeReply(&stream[1], TFLUNA_CMD_FRAME_RATE, rate, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_FALSE(sensor.poll());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_DONE, sensor.getCommandStatus(ticket));
+    
+    // Nor does a stray frame header
+    ticket = sensor.queueCommand(TFLUNA_CMD_FRAME_RATE, rate, 2, commandCallback);
+    stream[0] = TFLUNA_FRAME_HEADER;
+    length = 1 + makeReply(&stream[1], TFLUNA_CMD_FRAME_RATE, rate, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_FALSE(sensor.poll());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_DONE, sensor.getCommandStatus(ticket));
+    
+    // Commands run in order; a full queue refuses more
+    uint8_t tickets[TFLUNA_CMD_QUEUE_LENGTH];
+    for (uint8_t i = 0; i < TFLUNA_CMD_QUEUE_LENGTH; i++) {
+        tickets[i] = sensor.queueCommand(TFLUNA_CMD_SAVE_SETTINGS);
+        TEST_ASSERT_NOT_EQUAL(0, tickets[i]);
+    }
+    TEST_ASSERT_EQUAL(0, sensor.queueCommand(TFLUNA_CMD_SAVE_SETTINGS));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_BUSY, sensor.getErrorCode());
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_SENT, sensor.getCommandStatus(tickets[0]));
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_QUEUED, sensor.getCommandStatus(tickets[1]));
+    
+    uint8_t status = 0;
+    length = makeReply(stream, TFLUNA_CMD_SAVE_SETTINGS, &status, 1);
+    mockStream.setData(stream, length);
+    sensor.poll();
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_DONE, sensor.getCommandStatus(tickets[0]));
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_SENT, sensor.getCommandStatus(tickets[1]));
+    
+    // Unanswered commands time out without blocking
+    delay(TFLUNA_CMD_TIMEOUT_MS + 1);
+    sensor.poll();
+    TEST_ASSERT_EQUAL(TFLUNA_CMD_FAILED, sensor.getCommandStatus(tickets[1]));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, sensor.getCommandError(tickets[1]));
+    while (sensor.isCommandPending()) {
+        delay(TFLUNA_CMD_TIMEOUT_MS + 1);
+        sensor.poll();
+    }
+    
+    // Blocking configuration calls use the same path
+    length = makeReply(stream, TFLUNA_CMD_SAVE_SETTINGS, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setSaveSettings());
+    
+    uint8_t enable = 0x01;
+    length = makeReply(stream, TFLUNA_CMD_OUTPUT_ENABLE, &enable, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setEnable());
+    
+    // Triggers have no reply, the next data frame answers them
+    TEST_ASSERT_TRUE(sensor.triggerSample());
+    const uint8_t trigger[] = {0x5A, 0x04, 0x04, 0x62};
+    TEST_ASSERT_EQUAL_MEMORY(trigger, mockStream.written(), sizeof(trigger));
+    
+    // A frame rate the sensor did not take is not the one continuous mode
+    // goes back to
+    length = makeReply(stream, TFLUNA_CMD_FRAME_RATE, other, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_FALSE(sensor.setFrameRate(10));
+    const uint8_t defaultRate[] = {TFLUNA_DEFAULT_FRAME_RATE, 0};
+    length = makeReply(stream, TFLUNA_CMD_FRAME_RATE, defaultRate, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setContinuousMode());
+}
+
+void test_reset_readiness() {
+    TFLuna sensor(&mockStream);
+    uint8_t stream[20];
+    uint8_t status = 0;
+    
+    // UART: the reset reply, then the first frame from the restarted sensor
+    TEST_ASSERT_TRUE(sensor.startSoftReset());
+    TEST_ASSERT_EQUAL(TFLUNA_READY_WAITING, sensor.pollReady());
+    uint8_t length = makeReply(stream, TFLUNA_CMD_SOFT_RESET, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_EQUAL(TFLUNA_READY_WAITING, sensor.pollReady());
+    
+    // In trigger mode no frame comes unasked, so the sensor is triggered
+    delay(TFLUNA_READY_POLL_MS);
+    TEST_ASSERT_EQUAL(TFLUNA_READY_WAITING, sensor.pollReady());
+    const uint8_t trigger[] = {0x5A, 0x04, 0x04, 0x62};
+    TEST_ASSERT_EQUAL_MEMORY(trigger, mockStream.written(), sizeof(trigger));
+    
+    makeFrame(stream, 150);
+    mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+    TEST_ASSERT_EQUAL(TFLUNA_READY_OK, sensor.pollReady());
+    TEST_ASSERT_EQUAL(150, sensor.getDistance());
+    
+    // A sensor in continuous mode is ready with its next frame and is not
+    // triggered every interval while it is between frames
+    SimulatedSensor link;
+    SimulatedTFLuna streaming(&link);
+    link.frameRate = 100;
+    link.restart();
+    TEST_ASSERT_TRUE(streaming.begin());
+    TEST_ASSERT_EQUAL(TFLUNA_OK, streaming.getErrorCode());
+    TEST_ASSERT_TRUE(link.triggers <= 1);
+    link.frameRate = 20;
+    link.triggers = 0;
+    TEST_ASSERT_TRUE(streaming.begin());
+    TEST_ASSERT_TRUE(link.triggers <= 3);
+    
+    // One with its output disabled sends nothing; begin() still opens the port
+    TFLuna silent(&mockStream);
+    mockStream.setData(stream, 0);
+    TEST_ASSERT_TRUE(silent.begin());
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, silent.getErrorCode());
+    TFLuna::Statistics stats;
+    silent.getStatistics(stats);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+    
+    // A sensor that never comes back fails at the deadline
+    uint32_t start = millis();
+    mockStream.setData(stream, 0);
+    TEST_ASSERT_TRUE(sensor.startSoftReset());
+    length = makeReply(stream, TFLUNA_CMD_SOFT_RESET, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_FALSE(sensor.waitReady());
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, sensor.getErrorCode());
+    TEST_ASSERT_UINT32_WITHIN(2, TFLUNA_RESET_TIMEOUT_MS, millis() - start);
+    
+    // Unsaved settings are gone after a soft reset, saved ones stay
+    uint8_t format = TFLUNA_FORMAT_MM;
+    length = makeReply(stream, TFLUNA_CMD_OUTPUT_FORMAT, &format, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setOutputFormat(TFLUNA_FORMAT_MM));
+    length = makeReply(stream, TFLUNA_CMD_SAVE_SETTINGS, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setSaveSettings());
+    const uint8_t rate[] = {50, 0};
+    length = makeReply(stream, TFLUNA_CMD_FRAME_RATE, rate, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setFrameRate(50));
+    
+    TEST_ASSERT_TRUE(sensor.startSoftReset());
+    length = makeReply(stream, TFLUNA_CMD_SOFT_RESET, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_EQUAL(TFLUNA_READY_WAITING, sensor.pollReady());
+    makeFrame(stream, 150);
+    mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+    TEST_ASSERT_TRUE(sensor.waitReady());
+    TEST_ASSERT_EQUAL(TFLUNA_FORMAT_MM, sensor.getOutputFormat());
+    const uint8_t saved[] = {100, 0};
+    length = makeReply(stream, TFLUNA_CMD_FRAME_RATE, saved, 2);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setContinuousMode());
+    TEST_ASSERT_EQUAL_MEMORY(&stream[3], &mockStream.written()[3], 2);
+    
+    // A factory reset goes back to centimetres and 100 Hz
+    TEST_ASSERT_TRUE(sensor.startHardReset());
+    length = makeReply(stream, TFLUNA_CMD_FACTORY_RESET, &status, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_EQUAL(TFLUNA_READY_WAITING, sensor.pollReady());
+    makeFrame(stream, 150);
+    mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+    TEST_ASSERT_TRUE(sensor.waitReady());
+    TEST_ASSERT_EQUAL(TFLUNA_FORMAT_CM, sensor.getOutputFormat());
+    TEST_ASSERT_EQUAL(TFLUNA_DEFAULT_BAUD, sensor.getBaudRate());
+    
+    // I2C array: all sensors restart together and the wait ends with the
+    // slowest one, not after a fixed delay per sensor
+    RestartingArray array;
+    for (uint8_t i = 0; i < 4; i++) {
+        array.addSensor(0x10 + i);
+    }
+    start = millis();
+    array.readyAt[0] = start + 20;
+    array.readyAt[1] = start + 35;
+    array.readyAt[2] = start + 60;
+    array.readyAt[3] = start + 40;
+    TEST_ASSERT_TRUE(array.startReset());
+    TEST_ASSERT_TRUE(array.waitReady());
+    uint32_t elapsed = millis() - start;
+    TEST_ASSERT_TRUE(elapsed >= 60 && elapsed <= 60 + TFLUNA_READY_POLL_MS + 1);
+    TEST_ASSERT_TRUE(array.probes <= 4 * (60 / TFLUNA_READY_POLL_MS + 1));
+    
+    // One missing sensor fails the wait and is marked, the others are fine
+    start = millis();
+    array.readyAt[0] = start + 10;
+    array.readyAt[1] = 0;
+    array.readyAt[2] = start + 10;
+    array.readyAt[3] = start + 10;
+    TEST_ASSERT_TRUE(array.startReset());
+    TEST_ASSERT_FALSE(array.waitReady());
+    TEST_ASSERT_EQUAL(TFLUNA_READY_FAILED, array.pollReady());
+    TEST_ASSERT_EQUAL(TFLUNA_OK, array.getErrorCode(0));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, array.getErrorCode(1));
+    TEST_ASSERT_EQUAL(TFLUNA_OK, array.getErrorCode(3));
+    
+    // Probes that go unanswered are not bus errors
+    TFLuna absent(&Wire);
+    TEST_ASSERT_FALSE(absent.beginI2C(0x55));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, absent.getErrorCode());
+    absent.getStatistics(stats);
+    TEST_ASSERT_EQUAL(0, stats.nacks);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+}
+
+void test_baud_rate() {
+    SimulatedSensor link;
+    SimulatedTFLuna sensor(&link);
+    link.restart();
+    TEST_ASSERT_EQUAL(115200, sensor.getBaudRate());
+    
+    // 115200 baud carries at most 1280 frames per second; at 9600 the link
+    // cannot keep up with 250 Hz
+    uint32_t fast = measureFrameRate(sensor);
+    TEST_ASSERT_UINT32_WITHIN(10, 250, fast);
+    
+    TEST_ASSERT_FALSE(sensor.setBaudRate(12345));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_INVALID_PARAM, sensor.getErrorCode());
+    
+    TEST_ASSERT_TRUE(sensor.setBaudRate(9600));
+    TEST_ASSERT_EQUAL(9600, sensor.getBaudRate());
+    TEST_ASSERT_EQUAL(9600, link.sensorBaud);
+    uint32_t slow = measureFrameRate(sensor);
+    TEST_ASSERT_UINT32_WITHIN(10, 9600 / 10 / TFLUNA_FRAME_LENGTH, slow);
+    
+    // A sensor that does not follow the command is found again at its rate
+    link.followBaudCommand = false;
+    TEST_ASSERT_FALSE(sensor.setBaudRate(921600));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_COMMAND, sensor.getErrorCode());
+    TEST_ASSERT_EQUAL(9600, sensor.getBaudRate());
+    TEST_ASSERT_UINT32_WITHIN(10, 9600 / 10 / TFLUNA_FRAME_LENGTH, measureFrameRate(sensor));
+    link.followBaudCommand = true;
+    
+    // Detection walks the candidates until frames decode
+    link.sensorBaud = 460800;
+    link.restart();
+    TEST_ASSERT_EQUAL(460800, sensor.detectBaudRate());
+    TEST_ASSERT_EQUAL(460800, sensor.getBaudRate());
+    TEST_ASSERT_UINT32_WITHIN(10, 250, measureFrameRate(sensor));
+    
+    // After a factory reset the port follows the sensor back to 115200 baud
+    TEST_ASSERT_TRUE(sensor.setHardReset());
+    TEST_ASSERT_EQUAL(TFLUNA_DEFAULT_BAUD, sensor.getBaudRate());
+    TEST_ASSERT_EQUAL(TFLUNA_DEFAULT_BAUD, link.portBaud);
+    TEST_ASSERT_UINT32_WITHIN(10, 100, measureFrameRate(sensor));
+    link.frameRate = 250;
+    
+    // Nothing at any rate
+    link.sensorBaud = 1200;
+    TEST_ASSERT_EQUAL(0, sensor.detectBaudRate());
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_TIMEOUT, sensor.getErrorCode());
+    
+    // A plain Stream cannot change its rate
+    TFLuna plain(&mockStream);
+    TEST_ASSERT_EQUAL(0, plain.detectBaudRate());
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_SERIAL, plain.getErrorCode());
+    
+    // So the sensor is not told to switch and the link stays up
+    uint8_t none[1];
+    mockStream.setData(none, 0);
+    mockStream.write(none, 0);
+    TEST_ASSERT_FALSE(plain.setBaudRate(9600));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_SERIAL, plain.getErrorCode());
+    TEST_ASSERT_EQUAL(0, mockStream.writtenLength());
+    TEST_ASSERT_EQUAL(TFLUNA_DEFAULT_BAUD, plain.getBaudRate());
+}
+
+void test_millimetre_format() {
+    TFLunaAdvanced sensor(&mockStream);
+    uint8_t stream[40];
+    
+    TEST_ASSERT_FALSE(sensor.setOutputFormat(0x02));
+    TEST_ASSERT_EQUAL(TFLUNA_ERROR_INVALID_PARAM, sensor.getErrorCode());
+    
+    uint8_t format = TFLUNA_FORMAT_MM;
+    uint8_t length = makeReply(stream, TFLUNA_CMD_OUTPUT_FORMAT, &format, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setOutputFormat(TFLUNA_FORMAT_MM));
+    const uint8_t command[] = {0x5A, 0x05, 0x05, 0x06, 0x6A};
+    TEST_ASSERT_EQUAL_MEMORY(command, mockStream.written(), sizeof(command));
+    TEST_ASSERT_EQUAL(TFLUNA_FORMAT_MM, sensor.getOutputFormat());
+    
+    // Same frame layout, the distance field now counts millimetres
+    makeFrame(stream, 1234);
+    mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+    TEST_ASSERT_TRUE(sensor.getData());
+    TFLuna::Sample sample;
+    sensor.getSample(sample);
+    TEST_ASSERT_EQUAL(1234, sample.distance);
+    TEST_ASSERT_EQUAL(TFLUNA_UNIT_MM, sample.unit);
+    TEST_ASSERT_EQUAL(TFLUNA_UNIT_MM, sensor.getDistanceUnit());
+    
+    // Conversions follow the unit
+    TEST_ASSERT_EQUAL_UINT32(1234, sensor.getDistanceInMillimeters());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 1.234f, sensor.getDistanceInMeters());
+    TEST_ASSERT_UINT32_WITHIN(2, 80871, sensor.getDistanceInMetersQ16());    // 1.234 m
+    TEST_ASSERT_UINT32_WITHIN(2, 12437, sensor.getDistanceInInchesQ8());     // 48.58 in
+    TEST_ASSERT_TRUE(sensor.isSignalReliable());
+    
+    // The batch decoder tags samples the same way; a mixed batch converts
+    // each sample by its own unit
+    for (uint8_t i = 0; i < 4; i++) {
+        makeFrame(&stream[i * TFLUNA_FRAME_LENGTH], 1000 + i);
+    }
+    TFLuna::Sample samples[4];
+    size_t consumed, dropped;
+    TEST_ASSERT_EQUAL(4, sensor.decodeFrames(stream, 4 * TFLUNA_FRAME_LENGTH, samples, 4, consumed, dropped));
+    TEST_ASSERT_EQUAL(TFLUNA_UNIT_MM, samples[3].unit);
+    samples[1].distance = 100;
+    samples[1].unit = TFLUNA_UNIT_CM;
+    uint32_t millimeters[4];
+    TFLunaAdvanced::toMillimeters(samples, millimeters, 4);
+    TEST_ASSERT_EQUAL_UINT32(1000, millimeters[0]);
+    TEST_ASSERT_EQUAL_UINT32(1000, millimeters[1]);
+    TEST_ASSERT_EQUAL_UINT32(1003, millimeters[3]);
+    
+    // Filters see plain numbers and keep the millimetre resolution
+    sensor.enableMedianFilter(3);
+    const uint16_t distances[] = {500, 507, 2000, 503};
+    for (uint8_t i = 0; i < 4; i++) {
+        makeFrame(stream, distances[i]);
+        mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+        TEST_ASSERT_TRUE(sensor.getData());
+    }
+    TEST_ASSERT_EQUAL(507, sensor.getDistance());
+    
+    // Back to centimetres
+    format = TFLUNA_FORMAT_CM;
+    length = makeReply(stream, TFLUNA_CMD_OUTPUT_FORMAT, &format, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setOutputFormat(TFLUNA_FORMAT_CM));
+    TEST_ASSERT_EQUAL(TFLUNA_UNIT_CM, sensor.getDistanceUnit());
+    
+    // Switching while the filters and the tracker run: the windows start over
+    // instead of mixing units, and the track stays in cm without a jump
+    sensor.enableTracking(100);
+    for (uint8_t i = 0; i < 4; i++) {
+        makeFrame(stream, 100);
+        mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+        TEST_ASSERT_TRUE(sensor.getData());
+    }
+    TEST_ASSERT_EQUAL(100, sensor.getDistance());
+    TEST_ASSERT_EQUAL(100, sensor.getTrackedDistance());
+    
+    format = TFLUNA_FORMAT_MM;
+    length = makeReply(stream, TFLUNA_CMD_OUTPUT_FORMAT, &format, 1);
+    mockStream.setData(stream, length);
+    TEST_ASSERT_TRUE(sensor.setOutputFormat(TFLUNA_FORMAT_MM));
+    const uint16_t millimetres[] = {1003, 1004, 998, 1001};
+    const uint16_t medians[] = {1003, 1004, 1003, 1001};   // Raw until the window fills
+    for (uint8_t i = 0; i < 4; i++) {
+        makeFrame(stream, millimetres[i]);
+        mockStream.setData(stream, TFLUNA_FRAME_LENGTH);
+        TEST_ASSERT_TRUE(sensor.getData());
+        TEST_ASSERT_EQUAL(medians[i], sensor.getDistance());
+        TEST_ASSERT_EQUAL(100, sensor.getTrackedDistance());
+        TEST_ASSERT_EQUAL(0, sensor.getVelocity());
+    }
+}
+
+void test_auto_tuner() {
+    const uint16_t window = 100;
+    
+    // CPU budget: 3.5 ms per sample and a 50% budget allow 125 Hz, but the
+    // headroom rule stops at 100 Hz, where the next step would cost 44%
+    SimulatedTuner tuner;
+    tuner.setWindow(window);
+    tuner.setCpuBudget(50);
+    TEST_ASSERT_TRUE(tuner.begin(10));
+    TEST_ASSERT_EQUAL(10, tuner.deviceRate);
+    tuner.processMicros = 3500;
+    for (uint8_t i = 0; i < 40; i++) {
+        tuner.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(100, tuner.getFrameRate());
+    TEST_ASSERT_EQUAL(100, tuner.deviceRate);
+    TEST_ASSERT_EQUAL(35, tuner.getCpuPercent());
+    
+    // And it stays there
+    uint32_t adjustments = tuner.getAdjustmentCount();
+    for (uint8_t i = 0; i < 40; i++) {
+        tuner.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(adjustments, tuner.getAdjustmentCount());
+    
+    // A slower consumer drops frames; the tuner backs off and does not
+    // bounce back into the overload
+    tuner.processMicros = 15000;
+    for (uint8_t i = 0; i < 60; i++) {
+        tuner.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(25, tuner.getFrameRate());
+    TEST_ASSERT_EQUAL(0, tuner.getDropPercent());
+    adjustments = tuner.getAdjustmentCount();
+    for (uint8_t i = 0; i < 60; i++) {
+        tuner.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(adjustments, tuner.getAdjustmentCount());
+    
+    // Latency target: 20 ms is met by 50 Hz, so a light consumer starting at
+    // 250 Hz comes down to 50 Hz, and one starting at 5 Hz goes up to it
+    SimulatedTuner latency;
+    latency.setWindow(window);
+    latency.setLatencyTarget(20000);
+    latency.processMicros = 100;
+    latency.setLog(&logStream);
+    logStream.reset(0);
+    latency.begin(250);
+    for (uint8_t i = 0; i < 40; i++) {
+        latency.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(50, latency.getFrameRate());
+    TEST_ASSERT_EQUAL(3, latency.getAdjustmentCount());
+    const char expected[] = "TFLunaAutoTuner: 250 -> 125 Hz, delivered 250 Hz, drops 0%, cpu 2%\r\n";
+    TEST_ASSERT_GREATER_OR_EQUAL(sizeof(expected) - 1, logStream.length());
+    TEST_ASSERT_EQUAL_MEMORY(expected, logStream.data(), sizeof(expected) - 1);
+    
+    latency.begin(5);
+    for (uint8_t i = 0; i < 40; i++) {
+        latency.runWindow(window);
+    }
+    TEST_ASSERT_EQUAL(50, latency.getFrameRate());
+}
+
+void test_statistics() {
+    TFLuna counted(&mockStream);
+    TFLuna::Statistics stats;
+    counted.getStatistics(stats);
+    TEST_ASSERT_EQUAL(0, stats.framesOk);
+    TEST_ASSERT_EQUAL(0, stats.bytesDiscarded);
+    
+    // Noise, a lone header byte, a reply header with an impossible length,
+    // then a good frame and one with a bad checksum
+    uint8_t stream[32] = { 0x00, 0x59, 0x00, 0x5A, 0x20 };
+    uint8_t length = 5;
+    makeFrame(&stream[length], 100);
+    length += TFLUNA_FRAME_LENGTH;
+    makeFrame(&stream[length], 200);
+    stream[length + TFLUNA_FRAME_LENGTH - 1]++;
+    length += TFLUNA_FRAME_LENGTH;
+    mockStream.setData(stream, length);
+    
+    TEST_ASSERT_TRUE(counted.poll());
+    TEST_ASSERT_FALSE(counted.poll());
+    counted.getStatistics(stats);
+    TEST_ASSERT_EQUAL(1, stats.framesOk);
+    TEST_ASSERT_EQUAL(1, stats.checksumErrors);
+    TEST_ASSERT_EQUAL(2, stats.headerErrors);
+    TEST_ASSERT_EQUAL(5, stats.bytesDiscarded);
+    
+    // The batch decoder counts the same way
+    size_t consumed = 0;
+    size_t dropped = 0;
+    TFLuna::Sample samples[2];
+    TEST_ASSERT_EQUAL(1, counted.decodeFrames(&stream[5], 2 * TFLUNA_FRAME_LENGTH,
+                                              samples, 2, consumed, dropped));
+    counted.getStatistics(stats);
+    TEST_ASSERT_EQUAL(2, stats.framesOk);
+    TEST_ASSERT_EQUAL(2, stats.checksumErrors);
+    
+    // No data, then a command that is never answered
+    TEST_ASSERT_FALSE(counted.getData());
+    TEST_ASSERT_FALSE(counted.setFrameRate(10));
+    counted.getStatistics(stats);
+    TEST_ASSERT_EQUAL(2, stats.timeouts);
+    TEST_ASSERT_EQUAL(1, stats.commandFailures);
+    TEST_ASSERT_EQUAL(0, stats.nacks);
+    
+    counted.resetStatistics();
+    counted.getStatistics(stats);
+    TEST_ASSERT_EQUAL(0, stats.framesOk);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+    
+    // Nothing answers at this address
+    TFLuna absent(&Wire);
+    TEST_ASSERT_FALSE(absent.getDataI2C(0x55));
+    absent.getStatistics(stats);
+    TEST_ASSERT_EQUAL(1, stats.nacks);
+    TEST_ASSERT_EQUAL(0, stats.framesOk);
+}
+
+void test_latency_histogram() {
+    // Every bucket holds exactly the values between its edges
+    for (uint8_t i = 0; i < TFLUNA_LATENCY_BUCKETS - 1; i++) {
+        TEST_ASSERT_EQUAL(i, TFLunaLatencyHistogram::bucketOf(TFLunaLatencyHistogram::bucketLow(i)));
+        TEST_ASSERT_EQUAL(i, TFLunaLatencyHistogram::bucketOf(TFLunaLatencyHistogram::bucketHigh(i)));
+        TEST_ASSERT_EQUAL(TFLunaLatencyHistogram::bucketHigh(i) + 1, TFLunaLatencyHistogram::bucketLow(i + 1));
+    }
+    TEST_ASSERT_EQUAL(TFLUNA_LATENCY_BUCKETS - 1, TFLunaLatencyHistogram::bucketOf(5000000));
+    
+    // Percentiles are bucket upper edges, capped at the maximum
+    TFLunaLatencyHistogram histogram;
+    TEST_ASSERT_EQUAL(0, histogram.getPercentile(50));
+    for (uint32_t i = 1; i <= 100; i++) {
+        histogram.record(i);
+    }
+    TEST_ASSERT_EQUAL(100, histogram.getCount());
+    TEST_ASSERT_EQUAL(1, histogram.getMin());
+    TEST_ASSERT_EQUAL(100, histogram.getMax());
+    TEST_ASSERT_EQUAL(55, histogram.getPercentile(50));     // Bucket 48-55
+    TEST_ASSERT_EQUAL(100, histogram.getPercentile(99));    // Bucket 96-111
+    
+    // Saturating counts are halved, the distribution stays
+    histogram.reset();
+    for (uint32_t i = 0; i < 70000; i++) {
+        histogram.record(i % 10 == 0 ? 1000 : 10);
+    }
+    TEST_ASSERT_EQUAL(70000, histogram.getCount());
+    TEST_ASSERT_EQUAL(11, histogram.getPercentile(50));
+    TEST_ASSERT_EQUAL(1000, histogram.getPercentile(99));
+    
+#if TFLUNA_LATENCY_HISTOGRAM
+    // Per-phase timing of blocking reads
+    TFLuna timed(&mockStream);
+    uint8_t stream[2 * TFLUNA_FRAME_LENGTH];
+    makeFrame(stream, 100);
+    makeFrame(&stream[TFLUNA_FRAME_LENGTH], 200);
+    stream[2 * TFLUNA_FRAME_LENGTH - 1]++;
+    mockStream.setData(stream, sizeof(stream));
+    TEST_ASSERT_TRUE(timed.getData());
+    TEST_ASSERT_FALSE(timed.getData());
+    TEST_ASSERT_EQUAL(2, timed.getLatencyHistogram(TFLUNA_LATENCY_CALL).getCount());
+    TEST_ASSERT_EQUAL(1, timed.getLatencyHistogram(TFLUNA_LATENCY_HEADER).getCount());
+    TEST_ASSERT_EQUAL(1, timed.getLatencyHistogram(TFLUNA_LATENCY_PAYLOAD).getCount());
+    TEST_ASSERT_GREATER_THAN(0, timed.getLatencyPercentile(TFLUNA_LATENCY_PAYLOAD, 50));
+    TEST_ASSERT_EQUAL(0, timed.getLatencyPercentile(TFLUNA_LATENCY_BUS, 50));
+    
+    TFLuna absent(&Wire);
+    TEST_ASSERT_FALSE(absent.getDataI2C(0x55));
+    TEST_ASSERT_EQUAL(1, absent.getLatencyHistogram(TFLUNA_LATENCY_CALL).getCount());
+    TEST_ASSERT_EQUAL(1, absent.getLatencyHistogram(TFLUNA_LATENCY_BUS).getCount());
+    absent.resetLatency();
+    TEST_ASSERT_EQUAL(0, absent.getLatencyHistogram(TFLUNA_LATENCY_BUS).getCount());
+#endif
+}
+
+// Drain a stream through the parser, collecting the distances decoded
+uint8_t collectDistances(TFLuna &sensor, uint16_t* distances, uint8_t maxCount) {
+    uint8_t count = 0;
+    while (count < maxCount && sensor.poll()) {
+        distances[count++] = sensor.getDistance();
+    }
+    return count;
+}
+
+void test_capture_replay() {
+    // Record bursts 10 ms apart: clean frames, a corrupted one and noise
+    TFLunaRecorder recorder(&mockStream);
+    TFLuna recorded(&recorder);
+    logStream.reset(0);
+    TEST_ASSERT_TRUE(recorder.begin(&logStream, 230400));
+    
+    uint16_t expected[8];
+    uint8_t expectedCount = 0;
+    uint32_t fed = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        uint8_t burst[3 + TFLUNA_FRAME_LENGTH] = { 0x00, 0x59, 0x00 };
+        uint8_t offset = (i == 3) ? 3 : 0;
+        makeFrame(&burst[offset], 100 + i);
+        if (i == 2) {
+            burst[TFLUNA_FRAME_LENGTH - 1]++;
+        }
+        mockStream.setData(burst, offset + TFLUNA_FRAME_LENGTH);
+        fed += offset + TFLUNA_FRAME_LENGTH;
+        expectedCount += collectDistances(recorded, &expected[expectedCount], 8 - expectedCount);
+        delay(10);
+    }
+    recorder.end();
+    TEST_ASSERT_EQUAL(4, expectedCount);
+    TEST_ASSERT_EQUAL(fed, recorder.getRecordedBytes());
+    TEST_ASSERT_EQUAL(0, recorder.getDroppedBytes());
+    
+    // As fast as possible: the same frames, errors and resyncs
+    size_t length = logStream.length();
+    uint8_t capture[256];
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(capture), length);
+    memcpy(capture, logStream.data(), length);
+    
+    TFLunaReplayStream replay;
+    TEST_ASSERT_TRUE(replay.begin(capture, length));
+    TEST_ASSERT_EQUAL(230400, replay.getBaudRate());
+    TFLuna replayed(&replay);
+    uint16_t distances[8];
+    TEST_ASSERT_EQUAL(expectedCount, collectDistances(replayed, distances, 8));
+    TEST_ASSERT_EQUAL_MEMORY(expected, distances, expectedCount * sizeof(uint16_t));
+    TEST_ASSERT_TRUE(replay.isFinished());
+    TEST_ASSERT_FALSE(replay.isTruncated());
+    
+    TFLuna::Statistics original;
+    TFLuna::Statistics again;
+    recorded.getStatistics(original);
+    replayed.getStatistics(again);
+    TEST_ASSERT_EQUAL_MEMORY(&original, &again, sizeof(original));
+    
+    // Real time: the second burst is only there 10 ms after the first
+    TEST_ASSERT_TRUE(replay.begin(capture, length, true));
+    TFLuna paced(&replay);
+    delay(1);
+    TEST_ASSERT_TRUE(paced.poll());
+    TEST_ASSERT_FALSE(paced.poll());
+    TEST_ASSERT_EQUAL(0, replay.available());
+    delay(10);
+    TEST_ASSERT_TRUE(paced.poll());
+    TEST_ASSERT_EQUAL(101, paced.getDistance());
+    
+#ifdef TFLUNA_HOST_BUILD
+    // Gaps adding up to more than 2^32 us, read late across the micros()
+    // wrap: every chunk is still due its own gap after the one before
+    const uint32_t gaps[] = {0, 0x7FFF0000, 0x7FFF0000, 0x30000};
+    uint8_t wrapping[32];
+    size_t wrapLength = TFLUNA_CAPTURE_HEADER_LENGTH;
+    memcpy(wrapping, capture, wrapLength);
+    for (uint8_t i = 0; i < 4; i++) {
+        uint32_t gap = gaps[i];
+        while (gap >= 0x80) {
+            wrapping[wrapLength++] = (gap & 0x7F) | 0x80;
+            gap >>= 7;
+        }
+        wrapping[wrapLength++] = gap;
+        wrapping[wrapLength++] = 1;
+        wrapping[wrapLength++] = i;
+    }
+    TEST_ASSERT_TRUE(replay.begin(wrapping, wrapLength, true));
+    TEST_ASSERT_EQUAL(0, replay.read());
+    delayMicroseconds(0x7FFF0000);
+    TEST_ASSERT_EQUAL(1, replay.read());
+    delayMicroseconds(0x80018000);
+    TEST_ASSERT_EQUAL(2, replay.read());
+    TEST_ASSERT_EQUAL(-1, replay.read());      // Due 0x8000 us later
+    delayMicroseconds(0x8000);
+    TEST_ASSERT_EQUAL(3, replay.read());
+    TEST_ASSERT_TRUE(replay.isFinished());
+#endif
+    
+    // A capture cut short ends cleanly
+    TEST_ASSERT_TRUE(replay.begin(capture, length - 3));
+    TFLuna cut(&replay);
+    TEST_ASSERT_EQUAL(expectedCount - 1, collectDistances(cut, distances, 8));
+    TEST_ASSERT_TRUE(replay.isTruncated());
+    TEST_ASSERT_FALSE(replay.begin(capture + 1, length - 1));
+}
+
 void setup() {
     delay(2000);  // Give the serial monitor time to open
     
@@ -162,7 +1739,28 @@ void setup() {
     RUN_TEST(test_constructor);
     RUN_TEST(test_uart_data_parsing);
     RUN_TEST(test_uart_invalid_checksum);
+    RUN_TEST(test_uart_incremental_parser);
+    RUN_TEST(test_uart_batch_decode);
+    RUN_TEST(test_timestamped_sample);
+    RUN_TEST(test_sample_ring);
+    RUN_TEST(test_streaming_median);
+    RUN_TEST(test_median_average_chain);
+    RUN_TEST(test_filter_pipeline);
+    RUN_TEST(test_tracker_against_reference);
     RUN_TEST(test_advanced_filters);
+    RUN_TEST(test_fixed_point_conversions);
+    RUN_TEST(test_binary_logging);
+    RUN_TEST(test_text_logging);
+    RUN_TEST(test_sensor_array);
+    RUN_TEST(test_sensor_array_triggered);
+    RUN_TEST(test_async_commands);
+    RUN_TEST(test_reset_readiness);
+    RUN_TEST(test_baud_rate);
+    RUN_TEST(test_millimetre_format);
+    RUN_TEST(test_auto_tuner);
+    RUN_TEST(test_statistics);
+    RUN_TEST(test_latency_histogram);
+    RUN_TEST(test_capture_replay);
     
     UNITY_END();
 }